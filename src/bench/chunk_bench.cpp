@@ -0,0 +1,865 @@
+// Headless chunk pipeline benchmark
+//
+// Runs terrain generation (Chunk::Chunk) and meshing (Chunk::Generate) for a
+// fixed set of seeds and chunk coordinates without a window or a GL context,
+// and writes the results as JSON so runs can be compared. Every section also
+// checks its results, and the run fails if any check does:
+//   noise     SIMD backends against FastNoiseLite's scalar output
+//   chunks    binary meshing kernel against the scalar one, and each chunk's
+//             face connectivity against a plain labelling of its air
+//   parallel  the pipeline on the job system with one worker and with
+//             --threads workers, which must produce the same faces
+//   arena     the range allocator behind the vertex arena, churned with
+//             mesh-sized ranges, for overlaps and leaks
+//   frustum   SSE culling against the scalar test and against the boxes'
+//             corners in clip space
+//   eviction  a World on stand-in GL calls, whose chunks and memory must come
+//             down to lowered limits and load again once back in view
+//
+// Build (from the repository root, add -ldl -lpthread on Linux):
+//   g++ -O2 -std=c++17 -Iinclude -Isrc src/bench/chunk_bench.cpp src/world/*.cpp src/util/*.cpp lib/glad/src/glad.c -o chunk_bench
+//
+// Usage:
+//   chunk_bench [--out results.json] [--repeat N] [--threads N] [--seed S]...
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#ifdef _WIN32
+#include <malloc.h> // _aligned_malloc
+#endif
+
+#include <world/chunk.h>
+#include <world/heightmap.h>
+#include <world/world.h>
+#include <util/simdnoise.h>
+#include <util/threadpool.h>
+#include <util/rangeallocator.h>
+#include <util/frustum.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+
+// Allocation counting
+// ===================================================================================
+
+static atomic<size_t> alloc_count(0);
+static atomic<size_t> alloc_bytes(0);
+
+// Every replaceable operator new ends up here, so no allocation is missed.
+// The align_val_t forms pass their alignment and get memory from the
+// platform's aligned allocator, which AlignedFree gives back: MSVCRT has no
+// aligned_alloc, and its _aligned_malloc memory cannot go through free.
+static void *CountedAlloc(size_t size, size_t alignment) {
+    alloc_count++;
+    alloc_bytes += size;
+    size = max(size, size_t(1));
+    void *ptr;
+    if (alignment == 0)
+        ptr = malloc(size);
+    else
+#ifdef _WIN32
+        ptr = _aligned_malloc(size, alignment);
+#else
+        ptr = aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+    if (ptr)
+        return ptr;
+    throw bad_alloc();
+}
+
+static void AlignedFree(void *ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+void* operator new(size_t size) { return CountedAlloc(size, 0); }
+void* operator new[](size_t size) { return CountedAlloc(size, 0); }
+void* operator new(size_t size, align_val_t alignment) { return CountedAlloc(size, size_t(alignment)); }
+void* operator new[](size_t size, align_val_t alignment) { return CountedAlloc(size, size_t(alignment)); }
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+void operator delete(void *ptr, align_val_t) noexcept { AlignedFree(ptr); }
+void operator delete[](void *ptr, align_val_t) noexcept { AlignedFree(ptr); }
+void operator delete(void *ptr, size_t, align_val_t) noexcept { AlignedFree(ptr); }
+void operator delete[](void *ptr, size_t, align_val_t) noexcept { AlignedFree(ptr); }
+
+// Timing and report
+// ===================================================================================
+
+// Wall time and allocations of one stage, summed over every Time call
+struct Stage {
+    double seconds = 0.0;
+    size_t allocations = 0;
+    size_t bytes = 0;
+
+    template <typename F>
+    void Time(F &&run) {
+        size_t count = alloc_count, size = alloc_bytes;
+        auto start = chrono::steady_clock::now();
+        run();
+        seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        allocations += alloc_count - count;
+        bytes += alloc_bytes - size;
+    }
+
+    // Work items per second, 0 if nothing was timed
+    double Rate(double items) const {
+        return seconds > 0 ? items / seconds : 0.0;
+    }
+};
+
+// Results as JSON. Objects keep their keys in insertion order so reports of
+// different runs line up; containers of scalars are written on one line.
+class Json {
+    public:
+        Json() : kind(OBJECT) {}
+        Json(bool value) : kind(BOOLEAN), integer(value) {}
+        Json(double value) : kind(NUMBER), number(value) {}
+        Json(const char *value) : kind(STRING), text(value) {}
+        Json(const string &value) : kind(STRING), text(value) {}
+        template <typename T, typename = typename enable_if<is_integral<T>::value>::type>
+        Json(T value) : kind(INTEGER), integer(static_cast<long long>(value)) {}
+
+        static Json Array() {
+            Json json;
+            json.kind = ARRAY;
+            return json;
+        }
+
+        // Add a member to an object
+        Json &Set(const string &key, Json value) {
+            members.emplace_back(key, move(value));
+            return *this;
+        }
+        // Add an element to an array
+        Json &Push(Json value) {
+            members.emplace_back(string(), move(value));
+            return *this;
+        }
+
+        void Write(ostream &out, int indent = 0) const {
+            switch (kind) {
+                case BOOLEAN: out << (integer ? "true" : "false"); return;
+                case INTEGER: out << integer; return;
+                case NUMBER:
+                    // Rates of stages that took no measurable time
+                    if (isfinite(number))
+                        out << number;
+                    else
+                        out << "null";
+                    return;
+                case STRING: out << '"' << text << '"'; return;
+                default: break;
+            }
+
+            bool nested = false;
+            for (const auto &member : members)
+                nested |= member.second.kind == OBJECT || member.second.kind == ARRAY;
+            string pad = nested ? "\n" + string(indent + 2, ' ') : " ";
+
+            out << (kind == OBJECT ? '{' : '[');
+            for (size_t i = 0; i < members.size(); i++) {
+                out << (i ? "," : "") << pad;
+                if (kind == OBJECT)
+                    out << '"' << members[i].first << "\": ";
+                members[i].second.Write(out, indent + 2);
+            }
+            if (!members.empty())
+                out << (nested ? "\n" + string(indent, ' ') : " ");
+            out << (kind == OBJECT ? '}' : ']');
+        }
+
+    private:
+        enum Kind { OBJECT, ARRAY, BOOLEAN, INTEGER, NUMBER, STRING } kind;
+        long long integer = 0;
+        double number = 0.0;
+        string text;
+        vector<pair<string, Json>> members;
+};
+
+// Checks report through here; the run goes on but exits with an error
+static bool checks_passed = true;
+
+static ostream &Fail() {
+    checks_passed = false;
+    return cout;
+}
+
+// Noise backends
+// ===================================================================================
+
+// Maximum difference allowed between a SIMD backend and FastNoiseLite
+static const float NOISE_TOLERANCE = 1e-5f;
+
+static Json BenchNoise(const vector<int> &seeds) {
+    Json report = Json::Array();
+    for (SimdNoise::Backend backend : { SimdNoise::SCALAR, SimdNoise::SSE41, SimdNoise::AVX2 }) {
+        const char *name = SimdNoise::BackendName(backend);
+        Json entry;
+        entry.Set("backend", name);
+        entry.Set("supported", SimdNoise::Supported(backend));
+        if (!SimdNoise::Supported(backend)) {
+            cout << "noise " << name << ": not supported" << endl;
+            report.Push(entry);
+            continue;
+        }
+
+        // Golden values: compare against the scalar FastNoiseLite path over
+        // negative, positive and far-away origins with a width that leaves a tail
+        const int width = 37, depth = 33;
+        const float origins[][2] = { { 0, 0 }, { -64, -32 }, { 96, -160 }, { -32000, 48000 }, { 1048576, -1048576 } };
+        vector<float> expected(width * depth), actual(width * depth);
+        float max_error = 0.0f;
+        for (int seed : seeds)
+        for (const auto &origin : origins) {
+            SimdNoise noise(seed);
+            noise.FillGrid2D(SimdNoise::SCALAR, origin[0], origin[1], width, depth, expected.data());
+            noise.FillGrid2D(backend, origin[0], origin[1], width, depth, actual.data());
+            for (int i = 0; i < width * depth; i++)
+                max_error = max(max_error, fabs(expected[i] - actual[i]));
+        }
+
+        // Throughput over chunk-sized grids
+        const int grids = 2000;
+        float grid[CHUNK_SIZE * CHUNK_SIZE];
+        SimdNoise noise(seeds[0]);
+        Stage fill;
+        fill.Time([&]{
+            for (int i = 0; i < grids; i++)
+                noise.FillGrid2D(backend, float(i * CHUNK_SIZE), 0.0f, CHUNK_SIZE, CHUNK_SIZE, grid);
+        });
+        double samples_per_sec = fill.Rate(double(grids) * CHUNK_SIZE * CHUNK_SIZE);
+
+        cout << "noise " << name << ": " << samples_per_sec << " samples/s, max error " << max_error << endl;
+        if (max_error > NOISE_TOLERANCE)
+            Fail() << "noise " << name << " does not match FastNoiseLite" << endl;
+        entry.Set("max_abs_error", double(max_error));
+        entry.Set("samples_per_sec", samples_per_sec);
+        report.Push(entry);
+    }
+    return report;
+}
+
+// Chunk pipeline
+// ===================================================================================
+
+// Fixed chunk coordinates: a 5x3x5 block around the origin covering solid,
+// surface and air chunks
+static vector<glm::ivec3> BenchCoords() {
+    vector<glm::ivec3> coords;
+    for (int x = -2; x <= 2; x++)
+    for (int y = -1; y <= 1; y++)
+    for (int z = -2; z <= 2; z++)
+        coords.push_back(glm::ivec3(x, y, z));
+    return coords;
+}
+
+// Offset to each neighbor in Chunk::Direction order
+static const glm::ivec3 NEIGHBOR_OFFSETS[6] = {
+    glm::ivec3(0, 0, -1), glm::ivec3(0, 0, 1),
+    glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0),
+    glm::ivec3(0, -1, 0), glm::ivec3(0, 1, 0),
+};
+
+struct SeedResult {
+    int seed;
+    unsigned int chunks = 0;
+    unsigned long long faces[2][2] = {};
+    unsigned int mismatches = 0;
+    unsigned int connectivity_mismatches = 0;
+    unsigned long long block_bytes = 0;
+    unsigned int all_air = 0, all_solid = 0;
+    Stage generate, mesh[2][2];
+};
+
+// Split mesh vertices into quads and sort them, so meshes that emit the same
+// faces in a different order compare equal
+static vector<vector<uint32_t>> SortedQuads(const vector<uint32_t> &vertices) {
+    vector<vector<uint32_t>> quads;
+    for (size_t i = 0; i + 4 <= vertices.size(); i += 4)
+        quads.emplace_back(vertices.begin() + i, vertices.begin() + i + 4);
+    sort(quads.begin(), quads.end());
+    return quads;
+}
+
+// Face connectivity the slow way: label every air component of the chunk,
+// then join all faces each one touches
+static uint16_t ReferenceConnections(Chunk *chunk) {
+    const int size = CHUNK_SIZE;
+    vector<int> label(size * size * size, -1);
+    vector<glm::ivec3> queue;
+    uint16_t connections = 0;
+    for (int i = 0; i < size * size * size; i++) {
+        glm::ivec3 start(i % size, (i / size) % size, i / (size * size));
+        if (label[i] >= 0 || chunk->GetBlockData(start.x, start.y, start.z) != Chunk::AIR)
+            continue;
+
+        uint8_t faces = 0;
+        label[i] = i;
+        queue.assign(1, start);
+        for (size_t head = 0; head < queue.size(); head++) {
+            glm::ivec3 p = queue[head];
+            for (int d = 0; d < 6; d++) {
+                glm::ivec3 n = p + NEIGHBOR_OFFSETS[d];
+                if (!chunk->InBounds(n.x, n.y, n.z)) {
+                    faces |= 1 << d;
+                    continue;
+                }
+                int index = n.x + n.y * size + n.z * size * size;
+                if (label[index] < 0 && chunk->GetBlockData(n.x, n.y, n.z) == Chunk::AIR) {
+                    label[index] = i;
+                    queue.push_back(n);
+                }
+            }
+        }
+        for (int a = 0; a < 6; a++)
+        for (int b = a + 1; b < 6; b++)
+            if ((faces >> a & 1) && (faces >> b & 1))
+                connections |= 1 << Chunk::ConnectionBit(Chunk::Direction(a), Chunk::Direction(b));
+    }
+    return connections;
+}
+
+static SeedResult RunSeed(int seed, const vector<glm::ivec3> &coords, int repeat) {
+    SeedResult result;
+    result.seed = seed;
+
+    for (int r = 0; r < repeat; r++) {
+        // Fresh cache per pass so column heightmaps are computed once per column
+        HeightmapCache heightmaps(seed);
+        unordered_map<tuple<int, int, int>, Chunk*> chunks;
+
+        // Terrain generation
+        for (const glm::ivec3 &pos : coords) {
+            Chunk *chunk;
+            result.generate.Time([&]{ chunk = new Chunk(pos, nullptr, *heightmaps.Get(pos.x, pos.z)); });
+            chunks[make_tuple(pos.x, pos.y, pos.z)] = chunk;
+        }
+
+        // Meshing, with whichever neighbors are part of the fixed set
+        for (const glm::ivec3 &pos : coords) {
+            Chunk *chunk = chunks[make_tuple(pos.x, pos.y, pos.z)];
+            const Chunk *neighbors[6];
+            for (int d = 0; d < 6; d++) {
+                glm::ivec3 n = pos + NEIGHBOR_OFFSETS[d];
+                auto it = chunks.find(make_tuple(n.x, n.y, n.z));
+                neighbors[d] = it != chunks.end() ? it->second : nullptr;
+            }
+
+            // Every kernel/mesher pair, indexed by Chunk::MeshKernel and
+            // Chunk::MeshMode. The binary kernel must produce the same quads.
+            for (int mode = 0; mode < 2; mode++) {
+                vector<vector<uint32_t>> quads[2];
+                for (int kernel = 0; kernel < 2; kernel++) {
+                    Chunk::meshKernel = static_cast<Chunk::MeshKernel>(kernel);
+                    Chunk::meshMode = static_cast<Chunk::MeshMode>(mode);
+                    result.mesh[kernel][mode].Time([&]{ chunk->Generate(neighbors); });
+                    result.faces[kernel][mode] += chunk->vertexCount / 4;
+                    quads[kernel] = SortedQuads(chunk->GetMeshVertices());
+                }
+                if (quads[Chunk::SCALAR] != quads[Chunk::BINARY])
+                    result.mismatches++;
+            }
+
+            if (r == 0 && chunk->faceConnections != ReferenceConnections(chunk))
+                result.connectivity_mismatches++;
+
+            result.block_bytes += sizeof(PalettedContainer) + chunk->blockData.MemoryUsage();
+            result.all_air += chunk->GetUniformity() == Chunk::ALL_AIR;
+            result.all_solid += chunk->GetUniformity() == Chunk::ALL_SOLID;
+            result.chunks++;
+        }
+
+        for (auto &entry : chunks)
+            delete entry.second;
+    }
+
+    return result;
+}
+
+static Json StageJson(const Stage &stage, unsigned int chunks) {
+    const double blocks = double(chunks) * CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+    Json json;
+    json.Set("seconds", stage.seconds);
+    json.Set("chunks_per_sec", stage.Rate(chunks));
+    json.Set("ns_per_block", stage.seconds * 1e9 / blocks);
+    json.Set("allocations_per_chunk", double(stage.allocations) / chunks);
+    json.Set("bytes_per_chunk", double(stage.bytes) / chunks);
+    return json;
+}
+
+// Generation and every mesher per seed; greedy_faces gets the binary greedy
+// faces of all seeds, for the job system runs to match
+static Json BenchChunks(const vector<int> &seeds, const vector<glm::ivec3> &coords, int repeat, unsigned long long &greedy_faces) {
+    Json report = Json::Array();
+    greedy_faces = 0;
+    for (int seed : seeds) {
+        SeedResult r = RunSeed(seed, coords, repeat);
+        greedy_faces += r.faces[Chunk::BINARY][Chunk::GREEDY];
+
+        if (r.mismatches)
+            Fail() << "seed " << r.seed << ": binary kernel differs from scalar in " << r.mismatches << " meshes" << endl;
+        if (r.connectivity_mismatches)
+            Fail() << "seed " << r.seed << ": face connectivity differs from the reference in " << r.connectivity_mismatches << " chunks" << endl;
+        auto us = [&](int kernel, int mode) { return r.mesh[kernel][mode].seconds * 1e6 / r.chunks; };
+        cout << "seed " << r.seed
+             << ": generate " << r.generate.Rate(r.chunks) << " chunks/s"
+             << ", naive mesh " << us(Chunk::SCALAR, Chunk::NAIVE) << " us"
+             << " scalar / " << us(Chunk::BINARY, Chunk::NAIVE) << " us binary"
+             << " (" << double(r.faces[Chunk::BINARY][Chunk::NAIVE]) / r.chunks << " faces/chunk)"
+             << ", greedy mesh " << us(Chunk::SCALAR, Chunk::GREEDY) << " us"
+             << " scalar / " << us(Chunk::BINARY, Chunk::GREEDY) << " us binary"
+             << " (" << double(r.faces[Chunk::BINARY][Chunk::GREEDY]) / r.chunks << " faces/chunk)"
+             << ", " << double(r.block_bytes) / r.chunks << " block bytes/chunk" << endl;
+
+        Json entry;
+        entry.Set("seed", r.seed);
+        entry.Set("chunks", r.chunks);
+        entry.Set("faces_per_chunk_naive", double(r.faces[Chunk::BINARY][Chunk::NAIVE]) / r.chunks);
+        entry.Set("faces_per_chunk_greedy", double(r.faces[Chunk::BINARY][Chunk::GREEDY]) / r.chunks);
+        entry.Set("binary_scalar_mismatches", r.mismatches);
+        entry.Set("connectivity_mismatches", r.connectivity_mismatches);
+        entry.Set("block_bytes_per_chunk", double(r.block_bytes) / r.chunks);
+        entry.Set("all_air_chunks", double(r.all_air) / r.chunks);
+        entry.Set("all_solid_chunks", double(r.all_solid) / r.chunks);
+        entry.Set("generate", StageJson(r.generate, r.chunks));
+        entry.Set("mesh_scalar_naive", StageJson(r.mesh[Chunk::SCALAR][Chunk::NAIVE], r.chunks));
+        entry.Set("mesh_scalar_greedy", StageJson(r.mesh[Chunk::SCALAR][Chunk::GREEDY], r.chunks));
+        entry.Set("mesh_binary_naive", StageJson(r.mesh[Chunk::BINARY][Chunk::NAIVE], r.chunks));
+        entry.Set("mesh_binary_greedy", StageJson(r.mesh[Chunk::BINARY][Chunk::GREEDY], r.chunks));
+        report.Push(entry);
+    }
+    return report;
+}
+
+// Job system
+// ===================================================================================
+
+// Generate and then mesh (binary greedy) every chunk as a job on a pool of
+// each size, timing the whole pipeline by wall clock. The faces must match
+// the serial run's.
+static Json BenchParallel(const vector<int> &thread_counts, const vector<int> &seeds, const vector<glm::ivec3> &coords, int repeat, unsigned long long expected_faces) {
+    Json report = Json::Array();
+    Chunk::meshKernel = Chunk::BINARY;
+    Chunk::meshMode = Chunk::GREEDY;
+
+    for (int threads : thread_counts) {
+        ThreadPool pool(threads);
+        Stage pipeline;
+        unsigned int chunk_count = 0;
+        unsigned long long total_faces = 0;
+
+        for (int r = 0; r < repeat; r++)
+        for (int seed : seeds) {
+            HeightmapCache heightmaps(seed);
+            vector<Chunk*> chunks(coords.size());
+            atomic<unsigned long long> faces(0);
+
+            pipeline.Time([&]{
+                for (size_t i = 0; i < coords.size(); i++)
+                    pool.Submit([&, i]{ chunks[i] = new Chunk(coords[i], nullptr, *heightmaps.Get(coords[i].x, coords[i].z)); });
+                pool.Wait();
+
+                unordered_map<tuple<int, int, int>, Chunk*> lookup;
+                for (Chunk *chunk : chunks)
+                    lookup[make_tuple(int(chunk->offset.x), int(chunk->offset.y), int(chunk->offset.z))] = chunk;
+
+                for (size_t i = 0; i < coords.size(); i++) {
+                    pool.Submit([&, i]{
+                        const Chunk *neighbors[6];
+                        for (int d = 0; d < 6; d++) {
+                            glm::ivec3 n = coords[i] + NEIGHBOR_OFFSETS[d];
+                            auto it = lookup.find(make_tuple(n.x, n.y, n.z));
+                            neighbors[d] = it != lookup.end() ? it->second : nullptr;
+                        }
+                        chunks[i]->Generate(neighbors);
+                        faces += chunks[i]->vertexCount / 4;
+                    });
+                }
+                pool.Wait();
+            });
+            chunk_count += coords.size();
+            total_faces += faces;
+
+            for (Chunk *chunk : chunks)
+                delete chunk;
+        }
+
+        vector<ThreadPool::WorkerStats> stats = pool.Stats();
+        uint64_t stolen = 0;
+        Json workers = Json::Array();
+        for (const ThreadPool::WorkerStats &worker : stats) {
+            stolen += worker.stolen;
+            workers.Push(Json().Set("executed", worker.executed).Set("stolen", worker.stolen).Set("busy_seconds", worker.busy_seconds));
+        }
+
+        cout << "jobs " << pool.Size() << " threads: " << pipeline.Rate(chunk_count) << " chunks/s"
+             << " (generate + greedy binary mesh), " << stolen << " jobs stolen" << endl;
+        if (total_faces != expected_faces)
+            Fail() << "jobs " << pool.Size() << " threads: " << total_faces << " faces, expected " << expected_faces << endl;
+
+        Json entry;
+        entry.Set("threads", pool.Size());
+        entry.Set("chunks_per_sec", pipeline.Rate(chunk_count));
+        entry.Set("workers", workers);
+        report.Push(entry);
+    }
+    return report;
+}
+
+// Vertex arena allocator
+// ===================================================================================
+
+// Replace random live ranges with new ones of mesh-like sizes, the way
+// remeshing and unloading do in a VertexArena block, checking that no two
+// live ranges overlap and that everything merges back into one range at the
+// end
+static Json BenchArena(int repeat) {
+    const size_t capacity = size_t(64) << 20, alignment = 16;
+    const int live_ranges = 4096, operations = 200000 * repeat;
+    auto aligned = [&](size_t size) { return (size + alignment - 1) / alignment * alignment; };
+
+    RangeAllocator allocator(capacity, alignment);
+    mt19937 rng(1337);
+    // Mostly small meshes with a long tail, averaging about the greedy
+    // faces per chunk of the terrain seeds
+    exponential_distribution<double> quads(1.0 / 250);
+    uniform_int_distribution<int> pick(0, live_ranges - 1);
+    vector<pair<size_t, size_t>> live(live_ranges, make_pair(RangeAllocator::NONE, size_t(0)));
+    map<size_t, size_t> by_offset;
+    size_t used = 0;
+    unsigned long long failed = 0;
+    bool ok = true;
+
+    Stage churn;
+    churn.Time([&]{
+        for (int i = 0; i < operations; i++) {
+            pair<size_t, size_t> &range = live[pick(rng)];
+            if (range.first != RangeAllocator::NONE) {
+                allocator.Free(range.first, range.second);
+                by_offset.erase(range.first);
+                used -= aligned(range.second);
+            }
+
+            size_t size = (1 + size_t(quads(rng))) * 4 * sizeof(uint32_t);
+            size_t offset = allocator.Allocate(size);
+            range = make_pair(offset, size);
+            if (offset == RangeAllocator::NONE) {
+                failed++;
+                continue;
+            }
+            used += aligned(size);
+
+            // The new range must not touch its neighbors
+            auto next = by_offset.lower_bound(offset);
+            if (offset + size > capacity || offset % alignment != 0
+                || (next != by_offset.end() && offset + size > next->first)
+                || (next != by_offset.begin() && prev(next)->first + prev(next)->second > offset))
+                ok = false;
+            by_offset[offset] = size;
+        }
+    });
+
+    if (allocator.Used() != used)
+        ok = false;
+    size_t free_bytes = capacity - allocator.Used();
+    double fragmentation = free_bytes ? 1.0 - double(allocator.LargestFree()) / free_bytes : 0.0;  // 1 - largest free range / free bytes
+    size_t free_ranges = allocator.FreeRanges();
+
+    for (const pair<size_t, size_t> &range : live)
+        if (range.first != RangeAllocator::NONE)
+            allocator.Free(range.first, range.second);
+    if (allocator.Used() != 0 || allocator.FreeRanges() != 1 || allocator.LargestFree() != capacity)
+        ok = false;
+
+    cout << "arena allocator: " << churn.Rate(operations) << " free+allocate/s"
+         << ", " << failed << " failed, fragmentation " << fragmentation
+         << " over " << free_ranges << " free ranges" << endl;
+    if (!ok)
+        Fail() << "arena allocator: overlapping or leaked ranges" << endl;
+
+    Json report;
+    report.Set("ok", ok);
+    report.Set("operations_per_sec", churn.Rate(operations));
+    report.Set("failed_allocations", failed);
+    report.Set("fragmentation", fragmentation);
+    report.Set("free_ranges", free_ranges);
+    return report;
+}
+
+// Frustum culling
+// ===================================================================================
+
+// Chunk-sized boxes around random cameras, as World culls them
+static Json BenchFrustum(int repeat) {
+    Json report = Json::Array();
+    for (Frustum::Backend backend : { Frustum::SCALAR, Frustum::SSE }) {
+        const char *name = Frustum::BackendName(backend);
+        Json entry;
+        entry.Set("backend", name);
+        entry.Set("supported", Frustum::Supported(backend));
+        if (!Frustum::Supported(backend)) {
+            cout << "frustum " << name << ": not supported" << endl;
+            report.Push(entry);
+            continue;
+        }
+
+        const int radius = 16, height = 4, cameras = 16;
+        mt19937 rng(1337);
+        uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+
+        Frustum::Boxes boxes;
+        vector<uint8_t> visible, expected;
+        Stage cull;
+        unsigned long long tested = 0, in_view = 0;
+        unsigned long long mismatches = 0;     // differs from the scalar test
+        unsigned long long false_culls = 0;    // culled with a corner inside the view
+        for (int camera = 0; camera < cameras; camera++) {
+            glm::vec3 eye(unit(rng) * 1000.0f, unit(rng) * 100.0f, unit(rng) * 1000.0f);
+            glm::vec3 dir = glm::normalize(glm::vec3(unit(rng), unit(rng) * 0.5f, unit(rng)) + glm::vec3(0.0f, 0.0f, 1e-3f));
+            glm::mat4 view_projection = projection * glm::lookAt(eye, eye + dir, glm::vec3(0.0f, 1.0f, 0.0f));
+            Frustum frustum(view_projection);
+
+            boxes.Clear();
+            glm::ivec3 center = glm::ivec3(glm::floor(eye / float(CHUNK_SIZE)));
+            for (int z = -radius; z <= radius; z++)
+            for (int y = -height; y <= height; y++)
+            for (int x = -radius; x <= radius; x++) {
+                glm::vec3 min = glm::vec3(center + glm::ivec3(x, y, z)) * float(CHUNK_SIZE);
+                boxes.Add(min, min + glm::vec3(CHUNK_SIZE));
+            }
+            visible.assign(boxes.Size(), 0);
+            expected.assign(boxes.Size(), 0);
+
+            cull.Time([&]{
+                for (int r = 0; r < 20 * repeat; r++)
+                    in_view += frustum.Cull(backend, boxes, visible.data());
+            });
+            tested += boxes.Size() * 20 * repeat;
+
+            frustum.Cull(Frustum::SCALAR, boxes, expected.data());
+            for (size_t i = 0; i < boxes.Size(); i++) {
+                mismatches += visible[i] != expected[i];
+
+                // A box with a corner strictly inside the clip volume is in view
+                bool inside = false;
+                for (int corner = 0; corner < 8; corner++) {
+                    glm::vec4 clip = view_projection * glm::vec4(corner & 1 ? boxes.max_x[i] : boxes.min_x[i],
+                                                                 corner & 2 ? boxes.max_y[i] : boxes.min_y[i],
+                                                                 corner & 4 ? boxes.max_z[i] : boxes.min_z[i], 1.0f);
+                    inside |= fabs(clip.x) < clip.w && fabs(clip.y) < clip.w && fabs(clip.z) < clip.w;
+                }
+                false_culls += inside && !visible[i];
+            }
+        }
+
+        cout << "frustum " << name << ": " << cull.Rate(tested) << " boxes/s, "
+             << 100.0 * in_view / tested << "% visible" << endl;
+        if (mismatches || false_culls)
+            Fail() << "frustum " << name << ": " << mismatches << " mismatches, " << false_culls << " visible boxes culled" << endl;
+
+        entry.Set("boxes_per_sec", cull.Rate(tested));
+        entry.Set("visible_fraction", double(in_view) / tested);
+        entry.Set("mismatches", mismatches);
+        entry.Set("false_culls", false_culls);
+        report.Push(entry);
+    }
+    return report;
+}
+
+// Chunk eviction
+// ===================================================================================
+
+// Just enough GL for a World to upload and release chunk meshes without a
+// context: object names are counters, mapped buffers are plain memory and
+// fences have always signaled
+namespace HeadlessGL {
+    GLuint next_name = 1;
+    vector<unique_ptr<uint8_t[]>> mapped;
+
+    void APIENTRY GenNames(GLsizei n, GLuint *names) {
+        for (GLsizei i = 0; i < n; i++)
+            names[i] = next_name++;
+    }
+    void APIENTRY DeleteNames(GLsizei, const GLuint*) {}
+    void APIENTRY BindVertexArray(GLuint) {}
+    void APIENTRY BindBuffer(GLenum, GLuint) {}
+    void APIENTRY EnableVertexAttribArray(GLuint) {}
+    void APIENTRY VertexAttribIPointer(GLuint, GLint, GLenum, GLsizei, const void*) {}
+    void APIENTRY BufferData(GLenum, GLsizeiptr, const void*, GLenum) {}
+    void APIENTRY BufferStorage(GLenum, GLsizeiptr, const void*, GLbitfield) {}
+    void *APIENTRY MapBufferRange(GLenum, GLintptr, GLsizeiptr length, GLbitfield) {
+        mapped.emplace_back(new uint8_t[length]);
+        return mapped.back().get();
+    }
+    GLsync APIENTRY FenceSync(GLenum, GLbitfield) { return reinterpret_cast<GLsync>(uintptr_t(1)); }
+    GLenum APIENTRY ClientWaitSync(GLsync, GLbitfield, GLuint64) { return GL_ALREADY_SIGNALED; }
+    void APIENTRY DeleteSync(GLsync) {}
+
+    void Install() {
+        glad_glGenVertexArrays = GenNames;
+        glad_glGenBuffers = GenNames;
+        glad_glDeleteVertexArrays = DeleteNames;
+        glad_glDeleteBuffers = DeleteNames;
+        glad_glBindVertexArray = BindVertexArray;
+        glad_glBindBuffer = BindBuffer;
+        glad_glEnableVertexAttribArray = EnableVertexAttribArray;
+        glad_glVertexAttribIPointer = VertexAttribIPointer;
+        glad_glBufferData = BufferData;
+        glad_glBufferStorage = BufferStorage;
+        glad_glMapBufferRange = MapBufferRange;
+        glad_glFenceSync = FenceSync;
+        glad_glClientWaitSync = ClientWaitSync;
+        glad_glDeleteSync = DeleteSync;
+    }
+}
+
+// Fill a headless World's render distance around a fixed camera, then lower
+// its chunk limit and then its memory budget below what the range holds (not
+// below what the view draws, which is never evicted). The resident chunks
+// and their memory must come down to the limits, and the render list must
+// only hold resident chunks (every chunk in it is counted as drawn, culled,
+// occluded or empty). Turning around must load the evicted chunks again.
+static Json BenchEviction(int threads) {
+    HeadlessGL::Install();
+    Json report;
+    {
+        World world(nullptr, threads);
+        world.SetRenderDistance(4, 1);
+        const unsigned int in_range = 9 * 3 * 9;
+        const size_t max_chunks = world.max_resident_chunks, max_bytes = world.memory_budget;
+
+        glm::vec3 eye(16.0f, 40.0f, 16.0f), dir(1.0f, 0.0f, 0.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+        auto frame = [&]{
+            world.Update(eye, dir, Frustum(projection * glm::lookAt(eye, eye + dir, glm::vec3(0.0f, 1.0f, 0.0f))));
+            this_thread::sleep_for(chrono::milliseconds(1));
+        };
+        // Until every chunk in range is loaded and uploaded, then long enough
+        // for two eviction checks
+        auto settle = [&](unsigned int chunks) {
+            for (int i = 0; i < 20000 && (world.num_chunks < chunks || world.num_uploads_pending); i++)
+                frame();
+            for (int i = 0; i < 120; i++)
+                frame();
+        };
+        auto listed = [&]{ return world.num_chunks_rendered + world.num_chunks_culled + world.num_chunks_occluded + world.num_chunks_empty; };
+        bool ok = true;
+
+        settle(in_range);
+        unsigned int loaded = world.num_chunks, empty = world.num_chunks_empty;
+        size_t loaded_bytes = world.MemoryUsage();
+        ok &= loaded == in_range && listed() == in_range;
+
+        world.max_resident_chunks = loaded / 2;
+        settle(0);
+        unsigned int count_limited = world.num_chunks;
+        ok &= count_limited <= world.max_resident_chunks && listed() <= count_limited;
+
+        world.memory_budget = world.MemoryUsage() * 3 / 4;
+        settle(0);
+        unsigned int memory_limited = world.num_chunks;
+        size_t memory_limited_bytes = world.MemoryUsage(), budget = world.memory_budget;
+        ok &= memory_limited_bytes <= world.memory_budget && listed() <= memory_limited;
+
+        // Lift the limits and look the other way
+        world.max_resident_chunks = max_chunks;
+        world.memory_budget = max_bytes;
+        dir = -dir;
+        settle(memory_limited + 1);
+        unsigned int reloaded = world.num_chunks;
+        ok &= reloaded > memory_limited && listed() <= reloaded;
+
+        cout << "eviction: " << loaded << " chunks (" << loaded_bytes / 1024 << " KiB, " << empty << " with nothing to draw)"
+             << ", " << count_limited << " at a limit of " << loaded / 2
+             << ", " << memory_limited << " (" << memory_limited_bytes / 1024 << " KiB) at a budget of " << budget / 1024 << " KiB"
+             << ", " << reloaded << " after turning around" << endl;
+        if (!ok)
+            Fail() << "eviction: resident chunks or memory above the limits, or evicted chunks still listed" << endl;
+
+        report.Set("ok", ok);
+        report.Set("loaded_chunks", loaded);
+        report.Set("loaded_bytes", loaded_bytes);
+        report.Set("empty_chunks", empty);
+        report.Set("count_limited_chunks", count_limited);
+        report.Set("memory_limited_chunks", memory_limited);
+        report.Set("memory_limited_bytes", memory_limited_bytes);
+        report.Set("reloaded_chunks", reloaded);
+        report.Set("evicted", world.num_chunks_evicted);
+        report.Set("meshes_cancelled", world.num_meshes_cancelled.load());
+    }
+    HeadlessGL::mapped.clear();
+    return report;
+}
+
+int main(int argc, char **argv) {
+    string out_path = "bench_output.json";
+    int repeat = 3;
+    int threads = 0;
+    vector<int> seeds;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--out") && i + 1 < argc)
+            out_path = argv[++i];
+        else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+            repeat = max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+            seeds.push_back(atoi(argv[++i]));
+        else {
+            cout << "Usage: " << argv[0] << " [--out results.json] [--repeat N] [--threads N] [--seed S]..." << endl;
+            return 1;
+        }
+    }
+    if (seeds.empty())
+        seeds = { 1337, 42, 8675309 };
+
+    Json report;
+    report.Set("chunk_size", CHUNK_SIZE);
+    report.Set("repeat", repeat);
+
+    // Noise backends first, before the terrain uses the best one
+    report.Set("noise", BenchNoise(seeds));
+
+    vector<glm::ivec3> coords = BenchCoords();
+    unsigned long long greedy_faces;
+    report.Set("results", BenchChunks(seeds, coords, repeat, greedy_faces));
+    report.Set("parallel", BenchParallel({ 1, threads }, seeds, coords, repeat, greedy_faces));
+    report.Set("arena", BenchArena(repeat));
+    report.Set("frustum", BenchFrustum(repeat));
+    report.Set("eviction", BenchEviction(threads));
+
+    ofstream out(out_path);
+    if (!out) {
+        cout << "Failed to open " << out_path << endl;
+        return 1;
+    }
+    report.Write(out);
+    out << "\n";
+    cout << "Wrote " << out_path << endl;
+    return checks_passed ? 0 : 1;
+}
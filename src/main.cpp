@@ -14,7 +14,9 @@
 #include <world/chunk.h>
 #include <world/world.h>
 #include <util/camera.h>
+#include <util/frustum.h>
 #include <vfx/shader.h>
+#include <vfx/camerauniforms.h>
 #include <vfx/textures.h>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -91,6 +93,9 @@ int main() {
 
     shaderProgram.use();
 
+    // Camera matrices shared by all programs, uploaded once per frame
+    CameraUniforms cameraUniforms;
+
     // Load the textures
     loadTextures();
 
@@ -116,8 +121,21 @@ int main() {
         // If one second has passed, print the FPS and reset the frame count and total time
         if (totalTime >= 1.0)
         {
-            std::cout << "FPS: " << frameCount << std::endl;
+            std::cout << "FPS: " << frameCount << " (" << World::world->num_draw_calls << " chunk draw calls, "
+                      << World::world->num_chunks_culled << " chunks culled, "
+                      << World::world->num_chunks_occluded << " occluded)" << std::endl;
             frameCount = 0;
+
+            // Report chunk loads dropped since the last report
+            unsigned int cancelled = World::world->num_loads_cancelled.exchange(0);
+            if (cancelled > 0)
+                std::cout << "Chunk loads cancelled: " << cancelled << std::endl;
+            cancelled = World::world->num_meshes_cancelled.exchange(0);
+            if (cancelled > 0)
+                std::cout << "Chunk meshes cancelled: " << cancelled << std::endl;
+            if (World::world->num_uploads_pending > 0)
+                std::cout << "Chunk uploads waiting: " << World::world->num_uploads_pending
+                          << " (" << World::world->upload_bytes_pending / 1024 << " KB)" << std::endl;
             totalTime -= 1.0;
         }
 
@@ -138,12 +156,11 @@ int main() {
         glm::mat4 projection = glm::mat4(1.0f);
         projection = glm::perspective(glm::radians(camera.Zoom), float(SCR_WIDTH) / float(SCR_HEIGHT), 0.1f, 1000.0f); 
 
-        // Pass the matrices to the shader
-        shaderProgram.setMat4("projection", projection);
-        shaderProgram.setMat4("view", view);
+        // Pass the matrices to every shader
+        cameraUniforms.Update(projection, view);
 
-        // Load and render the chunks
-        World::world->Update(camera.Position);
+        // Load and render the chunks in view
+        World::world->Update(camera.Position, camera.Front, Frustum(projection * view));
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -157,6 +174,8 @@ int main() {
 }
 
 bool mKeyReleased = true;
+bool iKeyReleased = true;
+bool oKeyReleased = true;
 bool escKeyReleased = true;
 
 
@@ -196,6 +215,31 @@ void processInput(GLFWwindow *window)
     {
         mKeyReleased = true;
     }
+
+    // Toggle between per-chunk draws and multi-draw-indirect
+    if(glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS && iKeyReleased)
+    {
+        if(World::world->render_mode == World::MULTI_DRAW_INDIRECT)
+            World::world->render_mode = World::DRAW_PER_CHUNK;
+        else
+            World::world->render_mode = World::MULTI_DRAW_INDIRECT;
+        iKeyReleased = false;
+    }
+    else if(glfwGetKey(window, GLFW_KEY_I) == GLFW_RELEASE)
+    {
+        iKeyReleased = true;
+    }
+
+    // Toggle cave culling
+    if(glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS && oKeyReleased)
+    {
+        World::world->occlusion_culling = !World::world->occlusion_culling;
+        oKeyReleased = false;
+    }
+    else if(glfwGetKey(window, GLFW_KEY_O) == GLFW_RELEASE)
+    {
+        oKeyReleased = true;
+    }
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.ProcessKeyboard(FORWARD, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
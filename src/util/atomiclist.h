@@ -0,0 +1,62 @@
+#ifndef ATOMICLIST_H
+#define ATOMICLIST_H
+
+#include <atomic>
+#include <utility>
+
+// Multi-producer, single-consumer list. Producers push without taking a
+// lock; the consumer takes everything pushed so far with one atomic exchange,
+// so neither side ever waits for the other.
+template <typename T>
+class AtomicList {
+    public:
+        AtomicList() {}
+        AtomicList(const AtomicList&) = delete;
+        AtomicList& operator=(const AtomicList&) = delete;
+
+        ~AtomicList()
+        {
+            Drain([](T&) {});
+        }
+
+        // Any thread
+        void Push(T value)
+        {
+            Node *node = new Node{ std::move(value), head.load(std::memory_order_relaxed) };
+            while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        // Consumer thread only: call f on every value pushed so far, oldest
+        // first, and remove them
+        template <typename F>
+        void Drain(F f)
+        {
+            Node *node = head.exchange(nullptr, std::memory_order_acquire);
+
+            // The list is newest first; reverse it
+            Node *oldest = nullptr;
+            while (node) {
+                Node *next = node->next;
+                node->next = oldest;
+                oldest = node;
+                node = next;
+            }
+
+            while (oldest) {
+                Node *next = oldest->next;
+                f(oldest->value);
+                delete oldest;
+                oldest = next;
+            }
+        }
+
+    private:
+        struct Node {
+            T value;
+            Node *next;
+        };
+
+        std::atomic<Node*> head{nullptr};
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <mutex>
+#include <vector>
+
+// Free list of scratch vectors. A buffer is taken by the thread that fills it,
+// handed elsewhere (e.g. to the GL thread for upload) and returned once the
+// data has been consumed, so its capacity is reused instead of reallocated.
+template <typename T>
+class BufferPool {
+    public:
+        BufferPool(size_t max_buffers = 8) : max_buffers(max_buffers) {}
+
+        // An empty buffer, with capacity left over from earlier use if any
+        std::vector<T> Acquire()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (buffers.empty())
+                return std::vector<T>();
+            std::vector<T> buffer = std::move(buffers.back());
+            buffers.pop_back();
+            return buffer;
+        }
+
+        // Give a buffer back; it is freed if the pool is already full
+        void Release(std::vector<T> &&buffer)
+        {
+            buffer.clear();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (buffers.size() < max_buffers)
+                buffers.push_back(std::move(buffer));
+        }
+
+        size_t Size()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return buffers.size();
+        }
+
+    private:
+        std::mutex mutex;
+        std::vector<std::vector<T>> buffers;
+        size_t max_buffers;
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include <util/frustum.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FRUSTUM_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+void Frustum::Boxes::Clear() {
+    min_x.clear(); min_y.clear(); min_z.clear();
+    max_x.clear(); max_y.clear(); max_z.clear();
+}
+
+void Frustum::Boxes::Add(glm::vec3 min, glm::vec3 max) {
+    min_x.push_back(min.x); min_y.push_back(min.y); min_z.push_back(min.z);
+    max_x.push_back(max.x); max_y.push_back(max.y); max_z.push_back(max.z);
+}
+
+Frustum::Frustum() {
+    for (glm::vec4 &plane : planes)
+        plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+// Gribb/Hartmann: each clip plane is the last row of the matrix plus or minus
+// one of the others (glm is column-major, so row i is m[0][i]..m[3][i])
+Frustum::Frustum(const glm::mat4 &m) {
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+    planes[0] = rows[3] + rows[0];  // left
+    planes[1] = rows[3] - rows[0];  // right
+    planes[2] = rows[3] + rows[1];  // bottom
+    planes[3] = rows[3] - rows[1];  // top
+    planes[4] = rows[3] + rows[2];  // near
+    planes[5] = rows[3] - rows[2];  // far
+}
+
+// Only the box corner furthest along the plane normal needs testing: if even
+// that one is outside, the whole box is
+bool Frustum::Intersects(glm::vec3 min, glm::vec3 max) const {
+    for (const glm::vec4 &plane : planes) {
+        float x = plane.x >= 0.0f ? max.x : min.x;
+        float y = plane.y >= 0.0f ? max.y : min.y;
+        float z = plane.z >= 0.0f ? max.z : min.z;
+        if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+// Scalar
+// ===================================================================================
+
+static size_t CullScalar(const Frustum &frustum, const Frustum::Boxes &boxes, size_t start, uint8_t *visible) {
+    size_t count = 0;
+    for (size_t i = start; i < boxes.Size(); i++) {
+        glm::vec3 min(boxes.min_x[i], boxes.min_y[i], boxes.min_z[i]);
+        glm::vec3 max(boxes.max_x[i], boxes.max_y[i], boxes.max_z[i]);
+        visible[i] = frustum.Intersects(min, max);
+        count += visible[i];
+    }
+    return count;
+}
+
+// SSE: four boxes per iteration. The corner to test depends only on the
+// plane, so each plane picks its min or max arrays once.
+// ===================================================================================
+
+#ifdef FRUSTUM_X86
+
+// Tests the first Size() / 4 * 4 boxes
+__attribute__((target("sse2")))
+static size_t CullSSE(const glm::vec4 *planes, const Frustum::Boxes &boxes, uint8_t *visible) {
+    const float *x_arrays[6], *y_arrays[6], *z_arrays[6];
+    __m128 a[6], b[6], c[6], d[6];
+    for (int p = 0; p < 6; p++) {
+        x_arrays[p] = planes[p].x >= 0.0f ? boxes.max_x.data() : boxes.min_x.data();
+        y_arrays[p] = planes[p].y >= 0.0f ? boxes.max_y.data() : boxes.min_y.data();
+        z_arrays[p] = planes[p].z >= 0.0f ? boxes.max_z.data() : boxes.min_z.data();
+        a[p] = _mm_set1_ps(planes[p].x);
+        b[p] = _mm_set1_ps(planes[p].y);
+        c[p] = _mm_set1_ps(planes[p].z);
+        d[p] = _mm_set1_ps(planes[p].w);
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    size_t count = 0;
+    for (size_t i = 0; i + 4 <= boxes.Size(); i += 4) {
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            // Same order of operations as Intersects, so both agree exactly
+            __m128 distance = _mm_add_ps(_mm_mul_ps(a[p], _mm_loadu_ps(x_arrays[p] + i)), _mm_mul_ps(b[p], _mm_loadu_ps(y_arrays[p] + i)));
+            distance = _mm_add_ps(_mm_add_ps(distance, _mm_mul_ps(c[p], _mm_loadu_ps(z_arrays[p] + i))), d[p]);
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+        }
+        int mask = ~_mm_movemask_ps(outside) & 15;
+        for (int lane = 0; lane < 4; lane++)
+            visible[i + lane] = (mask >> lane) & 1;
+        count += __builtin_popcount(mask);
+    }
+    return count;
+}
+
+#endif
+
+// Dispatch
+// ===================================================================================
+
+size_t Frustum::Cull(const Boxes &boxes, uint8_t *visible) const {
+    return Cull(Supported(SSE) ? SSE : SCALAR, boxes, visible);
+}
+
+size_t Frustum::Cull(Backend backend, const Boxes &boxes, uint8_t *visible) const {
+#ifdef FRUSTUM_X86
+    if (backend == SSE && Supported(SSE)) {
+        // Leftover boxes past the last group of four go the scalar way
+        size_t count = CullSSE(planes, boxes, visible);
+        return count + CullScalar(*this, boxes, boxes.Size() / 4 * 4, visible);
+    }
+#endif
+    return CullScalar(*this, boxes, 0, visible);
+}
+
+bool Frustum::Supported(Backend backend) {
+    switch(backend){
+#ifdef FRUSTUM_X86
+        case SSE:
+            return __builtin_cpu_supports("sse2");
+#endif
+        case SCALAR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+const char* Frustum::BackendName(Backend backend) {
+    switch(backend){
+        case SSE: return "sse";
+        default: return "scalar";
+    }
+}
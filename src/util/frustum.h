@@ -0,0 +1,51 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// View frustum as six planes taken from a projection * view matrix. A box is
+// culled when it lies entirely on the outside of one plane; boxes near the
+// frustum's corners may pass without being visible, never the other way
+// round. Boxes are tested in batches, four at a time with SSE.
+class Frustum {
+    public:
+        enum Backend {
+            SCALAR,
+            SSE
+        };
+
+        // Axis-aligned boxes stored as separate coordinate arrays, so one
+        // SIMD load gets the same coordinate of several boxes
+        struct Boxes {
+            std::vector<float> min_x, min_y, min_z;
+            std::vector<float> max_x, max_y, max_z;
+
+            void Clear();
+            void Add(glm::vec3 min, glm::vec3 max);
+            size_t Size() const { return min_x.size(); }
+        };
+
+        // Default frustum contains everything
+        Frustum();
+        explicit Frustum(const glm::mat4 &view_projection);
+
+        bool Intersects(glm::vec3 min, glm::vec3 max) const;
+
+        // visible[i] = whether box i intersects the frustum; returns how many do
+        size_t Cull(const Boxes &boxes, uint8_t *visible) const;
+        // Same as above with an explicit backend; unsupported backends fall
+        // back to scalar
+        size_t Cull(Backend backend, const Boxes &boxes, uint8_t *visible) const;
+
+        static bool Supported(Backend backend);
+        static const char* BackendName(Backend backend);
+
+    private:
+        // a, b, c, d with a * x + b * y + c * z + d >= 0 inside
+        glm::vec4 planes[6];
+};
+
+#endif
@@ -1,3 +1,6 @@
+#ifndef HASHTUPLE_H
+#define HASHTUPLE_H
+
 #include <tuple>
 // function has to live in the std namespace 
 // so that it is picked up by argument-dependent name lookup (ADL).
@@ -50,4 +53,6 @@ namespace std {
         }
 
     };
-}
\ No newline at end of file
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include <util/rangeallocator.h>
+
+#include <algorithm>
+
+using namespace std;
+
+RangeAllocator::RangeAllocator(size_t capacity, size_t alignment) : capacity(capacity), alignment(alignment) {
+    if (capacity > 0)
+        free_ranges[0] = capacity;
+}
+
+size_t RangeAllocator::Allocate(size_t size) {
+    size = Align(max(size, size_t(1)));
+    for (auto it = free_ranges.begin(); it != free_ranges.end(); ++it) {
+        if (it->second < size)
+            continue;
+
+        // Take the front of the first range that fits
+        size_t offset = it->first, remaining = it->second - size;
+        free_ranges.erase(it);
+        if (remaining > 0)
+            free_ranges[offset + size] = remaining;
+        used += size;
+        return offset;
+    }
+    return NONE;
+}
+
+void RangeAllocator::Free(size_t offset, size_t size) {
+    size = Align(max(size, size_t(1)));
+    used -= size;
+
+    // Merge with the free range that ends where this one starts...
+    auto next = free_ranges.lower_bound(offset);
+    if (next != free_ranges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            free_ranges.erase(prev);
+        }
+    }
+
+    // ...and the one that starts where it ends
+    if (next != free_ranges.end() && offset + size == next->first) {
+        size += next->second;
+        free_ranges.erase(next);
+    }
+    free_ranges[offset] = size;
+}
+
+size_t RangeAllocator::LargestFree() const {
+    size_t largest = 0;
+    for (auto &range : free_ranges)
+        largest = max(largest, range.second);
+    return largest;
+}
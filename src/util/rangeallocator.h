@@ -0,0 +1,36 @@
+#ifndef RANGEALLOCATOR_H
+#define RANGEALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+// First-fit free-list allocator over [0, capacity). It only does the
+// bookkeeping, so it can carve up any buffer (a GL buffer, a mapped range).
+// Free ranges are kept sorted by offset and merged with their neighbors when
+// a range is given back. Not thread-safe.
+class RangeAllocator {
+    public:
+        static const size_t NONE = SIZE_MAX;
+
+        // Sizes are rounded up to a multiple of alignment
+        RangeAllocator(size_t capacity = 0, size_t alignment = 16);
+
+        // Offset of a free range of at least size bytes, or NONE
+        size_t Allocate(size_t size);
+        // Give back a range returned by Allocate with the same size
+        void Free(size_t offset, size_t size);
+
+        size_t Capacity() const { return capacity; }
+        size_t Used() const { return used; }
+        size_t LargestFree() const;
+        size_t FreeRanges() const { return free_ranges.size(); }
+
+    private:
+        size_t Align(size_t size) const { return (size + alignment - 1) / alignment * alignment; }
+
+        size_t capacity, alignment, used = 0;
+        std::map<size_t, size_t> free_ranges;   // offset -> size
+};
+
+#endif
@@ -0,0 +1,305 @@
+#include <util/simdnoise.h>
+#include <FastNoiseLite/FastNoiseLite.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMDNOISE_X86 1
+#include <immintrin.h>
+#endif
+
+// Same values as FastNoiseLite::Lookup<float>::Gradients2D, which is private
+alignas(32) static const float GRADIENTS_2D[] =
+{
+    0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+    0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+    0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+    -0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+    -0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+    -0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+    0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+    0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+    0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+    -0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+    -0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+    -0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+    0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+    0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+    0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+    -0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+    -0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+    -0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+    0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+    0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+    0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+    -0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+    -0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+    -0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+    0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+    0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+    0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+    -0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+    -0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+    -0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+    0.38268343236509f, 0.923879532511287f, 0.923879532511287f, 0.38268343236509f, 0.923879532511287f, -0.38268343236509f, 0.38268343236509f, -0.923879532511287f,
+    -0.38268343236509f, -0.923879532511287f, -0.923879532511287f, -0.38268343236509f, -0.923879532511287f, 0.38268343236509f, -0.38268343236509f, 0.923879532511287f,
+};
+
+// Constants from FastNoiseLite::SingleSimplex / TransformNoiseCoordinate,
+// evaluated the same way so the results match bit for bit where possible
+static const int PRIME_X = 501125321;
+static const int PRIME_Y = 1136930381;
+static const int HASH_MUL = 0x27d4eb2d;
+static const float SQRT3 = 1.7320508075688772935274463415059f;
+static const float F2 = 0.5f * (SQRT3 - 1);
+static const float G2 = (3 - SQRT3) / 6;
+static const float C_T = (float)(2 * (1 - 2 * G2) * (1 / G2 - 2));
+static const float C_A = (float)(-2 * (1 - 2 * G2) * (1 - 2 * G2));
+static const float OFFSET_2 = 2 * (float)G2 - 1;
+static const float SCALE = 99.83685446303647f;
+
+SimdNoise::SimdNoise(int seed, float frequency) : seed(seed), frequency(frequency) {}
+
+// Scalar
+// ===================================================================================
+
+static void FillScalar(int seed, float frequency, float origin_x, float origin_z, int x_begin, int width, int depth, float *out) {
+    FastNoiseLite noise(seed);
+    noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+    noise.SetFrequency(frequency);
+
+    for(int z = 0; z < depth; z++)
+    for(int x = x_begin; x < width; x++)
+        out[x + z * width] = noise.GetNoise(x + origin_x, z + origin_z);
+}
+
+#ifdef SIMDNOISE_X86
+
+// SSE4.1 (4 lanes)
+// ===================================================================================
+
+__attribute__((target("sse4.1")))
+static inline __m128 GradSSE41(__m128i seed, __m128i i, __m128i j, __m128 xd, __m128 yd) {
+    __m128i hash = _mm_xor_si128(seed, _mm_xor_si128(i, j));
+    hash = _mm_mullo_epi32(hash, _mm_set1_epi32(HASH_MUL));
+    hash = _mm_xor_si128(hash, _mm_srai_epi32(hash, 15));
+    hash = _mm_and_si128(hash, _mm_set1_epi32(127 << 1));
+
+    // No gather before AVX2, look the gradients up lane by lane
+    alignas(16) int idx[4];
+    _mm_store_si128((__m128i*)idx, hash);
+    __m128 xg = _mm_setr_ps(GRADIENTS_2D[idx[0]], GRADIENTS_2D[idx[1]], GRADIENTS_2D[idx[2]], GRADIENTS_2D[idx[3]]);
+    __m128 yg = _mm_setr_ps(GRADIENTS_2D[idx[0] | 1], GRADIENTS_2D[idx[1] | 1], GRADIENTS_2D[idx[2] | 1], GRADIENTS_2D[idx[3] | 1]);
+
+    return _mm_add_ps(_mm_mul_ps(xd, xg), _mm_mul_ps(yd, yg));
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128 Falloff4SSE41(__m128 a) {
+    __m128 a2 = _mm_mul_ps(a, a);
+    return _mm_mul_ps(a2, a2);
+}
+
+__attribute__((target("sse4.1")))
+static void FillSSE41(int seed_value, float frequency, float origin_x, float origin_z, int width, int depth, float *out, int &x_end) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128i seed = _mm_set1_epi32(seed_value);
+    const __m128i prime_x = _mm_set1_epi32(PRIME_X);
+    const __m128i prime_y = _mm_set1_epi32(PRIME_Y);
+    const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+
+    x_end = width - width % 4;
+    for(int z = 0; z < depth; z++)
+    for(int x = 0; x < x_end; x += 4){
+        // Frequency and skew (TransformNoiseCoordinate)
+        __m128 px = _mm_add_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x), lane)), _mm_set1_ps(origin_x));
+        __m128 py = _mm_set1_ps(z + origin_z);
+        px = _mm_mul_ps(px, _mm_set1_ps(frequency));
+        py = _mm_mul_ps(py, _mm_set1_ps(frequency));
+        __m128 s = _mm_mul_ps(_mm_add_ps(px, py), _mm_set1_ps(F2));
+        px = _mm_add_ps(px, s);
+        py = _mm_add_ps(py, s);
+
+        // FastFloor: truncate, minus one for negative inputs
+        __m128i i = _mm_add_epi32(_mm_cvttps_epi32(px), _mm_castps_si128(_mm_cmplt_ps(px, zero)));
+        __m128i j = _mm_add_epi32(_mm_cvttps_epi32(py), _mm_castps_si128(_mm_cmplt_ps(py, zero)));
+        __m128 xi = _mm_sub_ps(px, _mm_cvtepi32_ps(i));
+        __m128 yi = _mm_sub_ps(py, _mm_cvtepi32_ps(j));
+
+        __m128 t = _mm_mul_ps(_mm_add_ps(xi, yi), _mm_set1_ps(G2));
+        __m128 x0 = _mm_sub_ps(xi, t);
+        __m128 y0 = _mm_sub_ps(yi, t);
+
+        i = _mm_mullo_epi32(i, prime_x);
+        j = _mm_mullo_epi32(j, prime_y);
+
+        // First corner
+        __m128 a = _mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x0, x0)), _mm_mul_ps(y0, y0));
+        __m128 n0 = _mm_mul_ps(Falloff4SSE41(a), GradSSE41(seed, i, j, x0, y0));
+        n0 = _mm_and_ps(n0, _mm_cmpgt_ps(a, zero));
+
+        // Last corner
+        __m128 c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(C_T), t), _mm_add_ps(_mm_set1_ps(C_A), a));
+        __m128 x2 = _mm_add_ps(x0, _mm_set1_ps(OFFSET_2));
+        __m128 y2 = _mm_add_ps(y0, _mm_set1_ps(OFFSET_2));
+        __m128 n2 = _mm_mul_ps(Falloff4SSE41(c), GradSSE41(seed, _mm_add_epi32(i, prime_x), _mm_add_epi32(j, prime_y), x2, y2));
+        n2 = _mm_and_ps(n2, _mm_cmpgt_ps(c, zero));
+
+        // Middle corner depends on which triangle the point is in
+        __m128 upper = _mm_cmpgt_ps(y0, x0);
+        __m128i upper_i = _mm_castps_si128(upper);
+        __m128 x1 = _mm_add_ps(x0, _mm_blendv_ps(_mm_set1_ps(G2 - 1), _mm_set1_ps(G2), upper));
+        __m128 y1 = _mm_add_ps(y0, _mm_blendv_ps(_mm_set1_ps(G2), _mm_set1_ps(G2 - 1), upper));
+        __m128i i1 = _mm_add_epi32(i, _mm_andnot_si128(upper_i, prime_x));
+        __m128i j1 = _mm_add_epi32(j, _mm_and_si128(upper_i, prime_y));
+        __m128 b = _mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x1, x1)), _mm_mul_ps(y1, y1));
+        __m128 n1 = _mm_mul_ps(Falloff4SSE41(b), GradSSE41(seed, i1, j1, x1, y1));
+        n1 = _mm_and_ps(n1, _mm_cmpgt_ps(b, zero));
+
+        __m128 result = _mm_mul_ps(_mm_add_ps(_mm_add_ps(n0, n1), n2), _mm_set1_ps(SCALE));
+        _mm_storeu_ps(out + x + z * width, result);
+    }
+}
+
+// AVX2 (8 lanes)
+// ===================================================================================
+
+__attribute__((target("avx2")))
+static inline __m256 GradAVX2(__m256i seed, __m256i i, __m256i j, __m256 xd, __m256 yd) {
+    __m256i hash = _mm256_xor_si256(seed, _mm256_xor_si256(i, j));
+    hash = _mm256_mullo_epi32(hash, _mm256_set1_epi32(HASH_MUL));
+    hash = _mm256_xor_si256(hash, _mm256_srai_epi32(hash, 15));
+    hash = _mm256_and_si256(hash, _mm256_set1_epi32(127 << 1));
+
+    __m256 xg = _mm256_i32gather_ps(GRADIENTS_2D, hash, 4);
+    __m256 yg = _mm256_i32gather_ps(GRADIENTS_2D, _mm256_or_si256(hash, _mm256_set1_epi32(1)), 4);
+
+    return _mm256_add_ps(_mm256_mul_ps(xd, xg), _mm256_mul_ps(yd, yg));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 Falloff4AVX2(__m256 a) {
+    __m256 a2 = _mm256_mul_ps(a, a);
+    return _mm256_mul_ps(a2, a2);
+}
+
+__attribute__((target("avx2")))
+static void FillAVX2(int seed_value, float frequency, float origin_x, float origin_z, int width, int depth, float *out, int &x_end) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256i seed = _mm256_set1_epi32(seed_value);
+    const __m256i prime_x = _mm256_set1_epi32(PRIME_X);
+    const __m256i prime_y = _mm256_set1_epi32(PRIME_Y);
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    x_end = width - width % 8;
+    for(int z = 0; z < depth; z++)
+    for(int x = 0; x < x_end; x += 8){
+        // Frequency and skew (TransformNoiseCoordinate)
+        __m256 px = _mm256_add_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x), lane)), _mm256_set1_ps(origin_x));
+        __m256 py = _mm256_set1_ps(z + origin_z);
+        px = _mm256_mul_ps(px, _mm256_set1_ps(frequency));
+        py = _mm256_mul_ps(py, _mm256_set1_ps(frequency));
+        __m256 s = _mm256_mul_ps(_mm256_add_ps(px, py), _mm256_set1_ps(F2));
+        px = _mm256_add_ps(px, s);
+        py = _mm256_add_ps(py, s);
+
+        // FastFloor: truncate, minus one for negative inputs
+        __m256i i = _mm256_add_epi32(_mm256_cvttps_epi32(px), _mm256_castps_si256(_mm256_cmp_ps(px, zero, _CMP_LT_OQ)));
+        __m256i j = _mm256_add_epi32(_mm256_cvttps_epi32(py), _mm256_castps_si256(_mm256_cmp_ps(py, zero, _CMP_LT_OQ)));
+        __m256 xi = _mm256_sub_ps(px, _mm256_cvtepi32_ps(i));
+        __m256 yi = _mm256_sub_ps(py, _mm256_cvtepi32_ps(j));
+
+        __m256 t = _mm256_mul_ps(_mm256_add_ps(xi, yi), _mm256_set1_ps(G2));
+        __m256 x0 = _mm256_sub_ps(xi, t);
+        __m256 y0 = _mm256_sub_ps(yi, t);
+
+        i = _mm256_mullo_epi32(i, prime_x);
+        j = _mm256_mullo_epi32(j, prime_y);
+
+        // First corner
+        __m256 a = _mm256_sub_ps(_mm256_sub_ps(half, _mm256_mul_ps(x0, x0)), _mm256_mul_ps(y0, y0));
+        __m256 n0 = _mm256_mul_ps(Falloff4AVX2(a), GradAVX2(seed, i, j, x0, y0));
+        n0 = _mm256_and_ps(n0, _mm256_cmp_ps(a, zero, _CMP_GT_OQ));
+
+        // Last corner
+        __m256 c = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(C_T), t), _mm256_add_ps(_mm256_set1_ps(C_A), a));
+        __m256 x2 = _mm256_add_ps(x0, _mm256_set1_ps(OFFSET_2));
+        __m256 y2 = _mm256_add_ps(y0, _mm256_set1_ps(OFFSET_2));
+        __m256 n2 = _mm256_mul_ps(Falloff4AVX2(c), GradAVX2(seed, _mm256_add_epi32(i, prime_x), _mm256_add_epi32(j, prime_y), x2, y2));
+        n2 = _mm256_and_ps(n2, _mm256_cmp_ps(c, zero, _CMP_GT_OQ));
+
+        // Middle corner depends on which triangle the point is in
+        __m256 upper = _mm256_cmp_ps(y0, x0, _CMP_GT_OQ);
+        __m256i upper_i = _mm256_castps_si256(upper);
+        __m256 x1 = _mm256_add_ps(x0, _mm256_blendv_ps(_mm256_set1_ps(G2 - 1), _mm256_set1_ps(G2), upper));
+        __m256 y1 = _mm256_add_ps(y0, _mm256_blendv_ps(_mm256_set1_ps(G2), _mm256_set1_ps(G2 - 1), upper));
+        __m256i i1 = _mm256_add_epi32(i, _mm256_andnot_si256(upper_i, prime_x));
+        __m256i j1 = _mm256_add_epi32(j, _mm256_and_si256(upper_i, prime_y));
+        __m256 b = _mm256_sub_ps(_mm256_sub_ps(half, _mm256_mul_ps(x1, x1)), _mm256_mul_ps(y1, y1));
+        __m256 n1 = _mm256_mul_ps(Falloff4AVX2(b), GradAVX2(seed, i1, j1, x1, y1));
+        n1 = _mm256_and_ps(n1, _mm256_cmp_ps(b, zero, _CMP_GT_OQ));
+
+        __m256 result = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(n0, n1), n2), _mm256_set1_ps(SCALE));
+        _mm256_storeu_ps(out + x + z * width, result);
+    }
+}
+
+#endif
+
+// Dispatch
+// ===================================================================================
+
+bool SimdNoise::Supported(Backend backend) {
+    switch(backend){
+#ifdef SIMDNOISE_X86
+        case AVX2:
+            return __builtin_cpu_supports("avx2");
+        case SSE41:
+            return __builtin_cpu_supports("sse4.1");
+#endif
+        case SCALAR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+SimdNoise::Backend SimdNoise::BestBackend() {
+    static const Backend best = Supported(AVX2) ? AVX2 : Supported(SSE41) ? SSE41 : SCALAR;
+    return best;
+}
+
+const char* SimdNoise::BackendName(Backend backend) {
+    switch(backend){
+        case AVX2: return "avx2";
+        case SSE41: return "sse4.1";
+        default: return "scalar";
+    }
+}
+
+void SimdNoise::FillGrid2D(float origin_x, float origin_z, int width, int depth, float *out) const {
+    FillGrid2D(BestBackend(), origin_x, origin_z, width, depth, out);
+}
+
+void SimdNoise::FillGrid2D(Backend backend, float origin_x, float origin_z, int width, int depth, float *out) const {
+    // Columns [0, x_end) are handled by the vector kernel, the rest by scalar
+    int x_end = 0;
+    if(!Supported(backend))
+        backend = SCALAR;
+
+    switch(backend){
+#ifdef SIMDNOISE_X86
+        case AVX2:
+            FillAVX2(seed, frequency, origin_x, origin_z, width, depth, out, x_end);
+            break;
+        case SSE41:
+            FillSSE41(seed, frequency, origin_x, origin_z, width, depth, out, x_end);
+            break;
+#endif
+        default:
+            break;
+    }
+
+    if(x_end < width)
+        FillScalar(seed, frequency, origin_x, origin_z, x_end, width, depth, out);
+}
@@ -0,0 +1,36 @@
+#ifndef SIMDNOISE_H
+#define SIMDNOISE_H
+
+// Batched 2D OpenSimplex2 noise. Produces the same values as
+// FastNoiseLite::GetNoise(x, y) with NoiseType_OpenSimplex2 and no fractal,
+// but fills a whole grid per call using SSE4.1 or AVX2 lanes when the CPU
+// supports them.
+class SimdNoise {
+    public:
+        enum Backend {
+            SCALAR,
+            SSE41,
+            AVX2
+        };
+
+        SimdNoise(int seed = 1337, float frequency = 0.01f);
+
+        // Fill out[x + z * width] with the noise at (origin_x + x, origin_z + z)
+        // using the best backend available on this CPU
+        void FillGrid2D(float origin_x, float origin_z, int width, int depth, float *out) const;
+
+        // Same as above with an explicit backend; unsupported backends fall
+        // back to scalar
+        void FillGrid2D(Backend backend, float origin_x, float origin_z, int width, int depth, float *out) const;
+
+        // Best backend supported by this CPU (detected once)
+        static Backend BestBackend();
+        static bool Supported(Backend backend);
+        static const char* BackendName(Backend backend);
+
+    private:
+        int seed;
+        float frequency;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include <util/threadpool.h>
+#include <chrono>
+
+using namespace std;
+
+// Pool and worker index of the calling thread
+static thread_local const ThreadPool *current_pool = nullptr;
+static thread_local int current_index = -1;
+
+ThreadPool::ThreadPool(int threads) {
+    if (threads <= 0)
+        threads = max(1u, thread::hardware_concurrency());
+
+    for (int i = 0; i < threads; i++)
+        workers.emplace_back(new Worker());
+    for (int i = 0; i < threads; i++)
+        workers[i]->thread = thread(&ThreadPool::Run, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(sleep_mutex);
+        running = false;
+    }
+    wake.notify_all();
+
+    // Running jobs finish first; workers take no new ones once running is
+    // cleared, so whatever is still queued is dropped here
+    for (auto &worker : workers)
+        if (worker->thread.joinable())
+            worker->thread.join();
+    for (auto &worker : workers)
+        worker->jobs.clear();
+}
+
+int ThreadPool::WorkerIndex() {
+    return current_index;
+}
+
+void ThreadPool::Submit(Job job) {
+    int index = current_pool == this ? current_index : static_cast<int>(next_worker++ % workers.size());
+
+    // Count the job before it becomes visible so a thief never sees the
+    // counter go below zero
+    pending++;
+    {
+        lock_guard<mutex> lock(sleep_mutex);
+        queued++;
+    }
+    {
+        Worker &worker = *workers[index];
+        lock_guard<mutex> lock(worker.mutex);
+        worker.jobs.push_back(move(job));
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::Wait() {
+    unique_lock<mutex> lock(sleep_mutex);
+    idle.wait(lock, [this]{ return pending == 0; });
+}
+
+vector<ThreadPool::WorkerStats> ThreadPool::Stats() {
+    vector<WorkerStats> stats;
+    for (auto &worker : workers) {
+        lock_guard<mutex> lock(worker->mutex);
+        stats.push_back(worker->stats);
+    }
+    return stats;
+}
+
+// Newest job of our own deque
+bool ThreadPool::PopLocal(int index, Job &job) {
+    Worker &worker = *workers[index];
+    lock_guard<mutex> lock(worker.mutex);
+    if (worker.jobs.empty())
+        return false;
+    job = move(worker.jobs.back());
+    worker.jobs.pop_back();
+    return true;
+}
+
+// Oldest job of the first other worker that has one
+bool ThreadPool::Steal(int index, Job &job) {
+    int count = static_cast<int>(workers.size());
+    for (int i = 1; i < count; i++) {
+        Worker &victim = *workers[(index + i) % count];
+        lock_guard<mutex> lock(victim.mutex);
+        if (victim.jobs.empty())
+            continue;
+        job = move(victim.jobs.front());
+        victim.jobs.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::Run(int index) {
+    current_pool = this;
+    current_index = index;
+    Worker &self = *workers[index];
+
+    while (running) {
+        Job job;
+        bool stolen = false;
+        if (!PopLocal(index, job)) {
+            stolen = Steal(index, job);
+            if (!stolen) {
+                // Nothing anywhere; sleep until a job is queued
+                unique_lock<mutex> lock(sleep_mutex);
+                wake.wait(lock, [this]{ return !running || queued > 0; });
+                if (!running)
+                    return;
+                continue;
+            }
+        }
+        queued--;
+
+        auto start = chrono::steady_clock::now();
+        job();
+        chrono::duration<double> busy = chrono::steady_clock::now() - start;
+
+        {
+            lock_guard<mutex> lock(self.mutex);
+            self.stats.executed++;
+            self.stats.stolen += stolen;
+            self.stats.busy_seconds += busy.count();
+        }
+
+        if (--pending == 0) {
+            lock_guard<mutex> lock(sleep_mutex);
+            idle.notify_all();
+        }
+    }
+}
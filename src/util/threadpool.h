@@ -0,0 +1,83 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+// Flag shared between whoever queues a job and the job itself. The job polls
+// it at safe points and gives up early once it is set.
+class CancelToken {
+    public:
+        CancelToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+        void Cancel() { *flag = true; }
+        bool Cancelled() const { return *flag; }
+
+    private:
+        std::shared_ptr<std::atomic<bool>> flag;
+};
+
+// Work-stealing job system. Every worker owns a deque: it pushes and pops
+// its own jobs at the back (newest first, still hot in cache) while idle
+// workers steal the oldest jobs from the front of the others.
+class ThreadPool {
+    public:
+        typedef std::function<void()> Job;
+
+        struct WorkerStats {
+            uint64_t executed = 0;  // jobs run by this worker
+            uint64_t stolen = 0;    // of which taken from another worker
+            double busy_seconds = 0;
+        };
+
+        // threads <= 0 uses one worker per hardware thread
+        ThreadPool(int threads = 0);
+        // Waits for the running jobs; jobs still queued never run
+        ~ThreadPool();
+
+        // Queue a job. Jobs submitted from a worker go to that worker's deque,
+        // others are spread round-robin.
+        void Submit(Job job);
+
+        // Block until every queued job has finished (not from a worker)
+        void Wait();
+
+        int Size() const { return static_cast<int>(workers.size()); }
+        size_t Pending() const { return pending; }
+        std::vector<WorkerStats> Stats();
+
+        // Index of the calling worker in [0, Size()), or -1 off the pool
+        static int WorkerIndex();
+
+    private:
+        struct Worker {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+            WorkerStats stats;
+            std::thread thread;
+        };
+
+        void Run(int index);
+        bool PopLocal(int index, Job &job);
+        bool Steal(int index, Job &job);
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<size_t> pending{0};     // queued or running
+        std::atomic<size_t> queued{0};      // waiting in a deque
+        std::atomic<unsigned int> next_worker{0};
+        std::atomic<bool> running{true};
+
+        // Idle workers sleep here until a job is submitted
+        std::mutex sleep_mutex;
+        std::condition_variable wake;
+        std::condition_variable idle;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef CAMERAUNIFORMS_H
+#define CAMERAUNIFORMS_H
+
+#include <glad/glad.h> // OpenGL functions
+#include <glm/glm.hpp>
+
+// Camera matrices for the frame, in one uniform buffer bound at BINDING.
+// Every program that declares the Camera block (std140, binding = 0) reads
+// it, so the matrices are uploaded once per frame instead of set per program.
+class CameraUniforms {
+    public:
+        static const unsigned int BINDING = 0;
+
+        CameraUniforms()
+        {
+            glGenBuffers(1, &UBO);
+            glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+            glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, UBO);
+        }
+
+        void Update(const glm::mat4 &projection, const glm::mat4 &view)
+        {
+            Block block = { projection, view, projection * view };
+            glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+        }
+
+    private:
+        // std140 layout of the Camera block (mat4 columns are vec4-aligned,
+        // so it matches glm's)
+        struct Block {
+            glm::mat4 projection;
+            glm::mat4 view;
+            glm::mat4 viewProjection;
+        };
+
+        unsigned int UBO;
+};
+
+#endif
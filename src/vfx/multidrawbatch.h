@@ -0,0 +1,126 @@
+#ifndef MULTIDRAWBATCH_H
+#define MULTIDRAWBATCH_H
+
+#include <glad/glad.h> // OpenGL functions
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include <vfx/shader.h>
+#include <vfx/vertexarena.h>
+
+// Layout of one command in the indirect buffer, as glMultiDrawElementsIndirect
+// reads it
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Every chunk mesh in one VertexArena block shares a VAO and the quad index
+// buffer, so a frame's chunks can be drawn with one glMultiDrawElementsIndirect
+// per block instead of a bind, a uniform and a draw call each. The chunk
+// origins go into a shader storage buffer the vertex shader indexes with
+// drawOffset + gl_DrawID. Both buffers are refilled every frame.
+class MultiDrawBatch {
+    public:
+        // Draws with the chunk shader, whose uniforms are looked up once here
+        MultiDrawBatch(const Shader *shader = nullptr) : shader(shader)
+        {
+            if (shader) {
+                indirect = shader->getUniform<bool>("indirect");
+                drawOffset = shader->getUniform<int>("drawOffset");
+            }
+        }
+
+        ~MultiDrawBatch()
+        {
+            if (commandBuffer)
+                glDeleteBuffers(1, &commandBuffer);
+            if (originBuffer)
+                glDeleteBuffers(1, &originBuffer);
+        }
+
+        void Clear()
+        {
+            for (Batch &batch : batches) {
+                batch.commands.clear();
+                batch.origins.clear();
+            }
+        }
+
+        // Queue a mesh of quads in an arena range, drawn at origin
+        void Add(const ArenaRange &range, unsigned int quads, glm::vec3 origin)
+        {
+            if (range.block >= static_cast<int>(batches.size()))
+                batches.resize(range.block + 1);
+            Batch &batch = batches[range.block];
+            batch.commands.push_back({ quads * 6, 1, 0, static_cast<GLint>(range.offset / sizeof(uint32_t)), 0 });
+            batch.origins.push_back(glm::vec4(origin, 0.0f));
+        }
+
+        // Draw everything queued since Clear with the chunk shader (already in
+        // use). Returns the number of draw calls made.
+        unsigned int Draw(VertexArena &arena)
+        {
+            commands.clear();
+            origins.clear();
+            for (Batch &batch : batches) {
+                commands.insert(commands.end(), batch.commands.begin(), batch.commands.end());
+                origins.insert(origins.end(), batch.origins.begin(), batch.origins.end());
+            }
+            if (commands.empty())
+                return 0;
+
+            if (!commandBuffer) {
+                glGenBuffers(1, &commandBuffer);
+                glGenBuffers(1, &originBuffer);
+            }
+
+            // Orphan and refill, so the driver never waits on last frame's draws
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, originBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, origins.size() * sizeof(glm::vec4), origins.data(), GL_STREAM_DRAW);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, originBuffer);
+
+            shader->set(indirect, true);
+            unsigned int draws = 0;
+            size_t first = 0;
+            for (int block = 0; block < static_cast<int>(batches.size()); block++) {
+                size_t count = batches[block].commands.size();
+                if (count == 0)
+                    continue;
+
+                arena.Bind(block);
+                shader->set(drawOffset, static_cast<int>(first));
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(first * sizeof(DrawElementsIndirectCommand)), static_cast<GLsizei>(count), 0);
+                first += count;
+                draws++;
+            }
+            shader->set(indirect, false);
+            return draws;
+        }
+
+    private:
+        // Draws of the meshes in one arena block
+        struct Batch {
+            std::vector<DrawElementsIndirectCommand> commands;
+            std::vector<glm::vec4> origins;
+        };
+        std::vector<Batch> batches;
+
+        // Scratch for the concatenated batches, kept between frames
+        std::vector<DrawElementsIndirectCommand> commands;
+        std::vector<glm::vec4> origins;
+
+        unsigned int commandBuffer = 0, originBuffer = 0;
+
+        const Shader *shader;
+        Uniform<bool> indirect;
+        Uniform<int> drawOffset;
+};
+
+#endif
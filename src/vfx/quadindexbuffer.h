@@ -0,0 +1,44 @@
+#ifndef QUADINDEXBUFFER_H
+#define QUADINDEXBUFFER_H
+
+#include <glad/glad.h> // OpenGL functions
+
+#include <vector>
+
+// Every chunk mesh is a list of quads drawn with the same index pattern
+// ({0, 1, 2, 2, 3, 0} offset by 4 per quad), so a single element buffer is
+// shared by all chunk VAOs instead of each chunk building and uploading its own.
+class QuadIndexBuffer {
+    public:
+        // Bind the shared buffer to the current VAO, growing it first if it
+        // holds fewer than quads quads. Growing reuses the same buffer name, so
+        // VAOs bound earlier keep working.
+        static void Bind(unsigned int quads)
+        {
+            if (EBO == 0)
+                glGenBuffers(1, &EBO);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+            if (quads <= capacity)
+                return;
+
+            // Grow in powers of two, starting big enough for typical chunks
+            unsigned int new_capacity = capacity ? capacity : 16384;
+            while (new_capacity < quads)
+                new_capacity *= 2;
+
+            std::vector<unsigned int> indices(new_capacity * 6);
+            for (unsigned int q = 0; q < new_capacity; q++)
+                for (int i = 0; i < 6; i++)
+                    indices[q * 6 + i] = QUAD_INDICES[i] + q * 4;
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+            capacity = new_capacity;
+        }
+
+    private:
+        static constexpr unsigned int QUAD_INDICES[6] = { 0, 1, 2, 2, 3, 0 };
+        static inline unsigned int EBO = 0;
+        static inline unsigned int capacity = 0;
+};
+
+#endif
@@ -5,10 +5,19 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <string>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// Location of a uniform, resolved once and typed by the value it takes
+// (-1 if the program has no such active uniform, which GL ignores)
+template <typename T>
+struct Uniform
+{
+    int location = -1;
+};
+
 class Shader
 {
     public:
@@ -43,7 +52,7 @@ class Shader
                 vertexCode   = vShaderStream.str();
                 fragmentCode = fShaderStream.str();		
             }
-            catch(std::ifstream::failure e)
+            catch(std::ifstream::failure &)
             {
                 std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
             }
@@ -75,6 +84,8 @@ class Shader
             // delete the shaders as they're linked into our program now and no longer necessary
             glDeleteShader(vertex);
             glDeleteShader(fragment);
+
+            cacheUniformLocations();
         }            
 
         // use/activate the shader
@@ -82,29 +93,86 @@ class Shader
             glUseProgram(ID);
         }
         
-        // utility uniform functions
+        // look up a uniform once (no GL call, safe from any thread) and keep
+        // the handle for the draw loop
+        // -------------------------------------------------------------------
+        template <typename T>
+        Uniform<T> getUniform(const std::string &name) const
+        {
+            auto it = uniformLocations.find(name);
+            return Uniform<T>{ it != uniformLocations.end() ? it->second : -1 };
+        }
+
+        // utility uniform functions (the program must be in use)
+        // -------------------------------------------------------------------
+        void set(Uniform<bool> uniform, bool value) const
+        {
+            glUniform1i(uniform.location, (int) value);
+        }
+        void set(Uniform<int> uniform, int value) const
+        {
+            glUniform1i(uniform.location, value);
+        }
+        void set(Uniform<float> uniform, float value) const
+        {
+            glUniform1f(uniform.location, value);
+        }
+        void set(Uniform<glm::mat4> uniform, const glm::mat4 &value) const
+        {
+            glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(value));
+        }
+
+        // by name, for one-off setup; prefer handles in per-frame code
         // -------------------------------------------------------------------
         void setBool(const std::string &name, bool value) const
         {
-            glUniform1i(glGetUniformLocation(ID, name.c_str()), (int) value);
+            set(getUniform<bool>(name), value);
         }
         // -------------------------------------------------------------------
         void setInt(const std::string &name, int value) const 
         {
-            glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+            set(getUniform<int>(name), value);
         }
         // -------------------------------------------------------------------
         void setFloat(const std::string &name, float value) const
         {
-            glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+            set(getUniform<float>(name), value);
         }
         // -------------------------------------------------------------------
         void setMat4(const std::string &name, glm::mat4 value) const
         {
-            glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+            set(getUniform<glm::mat4>(name), value);
         }
 
     private:
+    // active uniform name -> location, filled once after linking
+    std::unordered_map<std::string, int> uniformLocations;
+
+    // ask the linked program for all its active uniforms. Members of uniform
+    // blocks have no location and are skipped; arrays are stored under both
+    // "name[0]" and "name".
+    // ------------------------------------------------------------------------
+    void cacheUniformLocations()
+    {
+        int count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string name(maxLength, '\0');
+        for (int i = 0; i < count; i++)
+        {
+            int length = 0, size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, i, maxLength, &length, &size, &type, &name[0]);
+            std::string uniformName = name.substr(0, length);
+            int location = glGetUniformLocation(ID, uniformName.c_str());
+            if (location < 0)
+                continue;
+            uniformLocations[uniformName] = location;
+            if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+                uniformLocations[uniformName.substr(0, uniformName.size() - 3)] = location;
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(unsigned int shader, std::string type)
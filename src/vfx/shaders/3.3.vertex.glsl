@@ -1,22 +1,51 @@
 #version 460 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aTexCoord;
-layout (location = 2) in float aLight;
-layout (location = 3) in float aTexLayer;
+// Packed chunk vertex, see the layout in world/chunk.h
+layout (location = 0) in uint aData;
 
-out vec3 v_color;
 out vec2 v_texCoord;
 out float v_light;
 out float v_texLayer;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// Shared by all programs, updated once per frame (see vfx/camerauniforms.h)
+layout (std140, binding = 0) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    mat4 viewProjection;
+};
+
+// Multi-draw-indirect path (see vfx/multidrawbatch.h): chunk origins come
+// from chunkOrigins[drawOffset + gl_DrawID] instead of the model matrix
+uniform bool indirect;
+uniform int drawOffset;
+layout (std430, binding = 0) readonly buffer ChunkOrigins {
+    vec4 chunkOrigins[];
+};
+
+// Pseudo-lighting per face (north, south, west, east, bottom, top)
+const float FACE_LIGHT[6] = float[6](0.86, 0.86, 0.8, 0.8, 0.6, 1.0);
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-    v_texCoord = aTexCoord;
-    v_light = aLight;
-    v_texLayer = aTexLayer;
-}
\ No newline at end of file
+    vec3 pos = vec3(aData & 63u, (aData >> 6) & 63u, (aData >> 12) & 63u);
+    uint face = (aData >> 18) & 7u;
+    uint layer = (aData >> 21) & 255u;
+
+    // Texture coords repeat once per block along the face's axes
+    vec2 texCoord;
+    switch (face)
+    {
+        case 0u: texCoord = vec2( pos.x, pos.y); break; // north
+        case 1u: texCoord = vec2(-pos.x, pos.y); break; // south
+        case 2u: texCoord = vec2(-pos.z, pos.y); break; // west
+        case 3u: texCoord = vec2( pos.z, pos.y); break; // east
+        default: texCoord = vec2( pos.z, pos.x); break; // bottom, top
+    }
+
+    vec4 worldPos = indirect ? vec4(pos + chunkOrigins[drawOffset + gl_DrawID].xyz, 1.0) : model * vec4(pos, 1.0);
+    gl_Position = viewProjection * worldPos;
+    v_texCoord = texCoord;
+    v_light = FACE_LIGHT[face];
+    v_texLayer = float(layer);
+}
@@ -0,0 +1,193 @@
+#ifndef VERTEXARENA_H
+#define VERTEXARENA_H
+
+#include <glad/glad.h> // OpenGL functions
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <util/rangeallocator.h>
+#include <vfx/quadindexbuffer.h>
+
+// Where a mesh lives in a VertexArena
+struct ArenaRange {
+    int block = -1;
+    size_t offset = 0, size = 0;
+
+    bool Valid() const { return block >= 0; }
+};
+
+// Chunk vertex storage shared by all chunks: a few large buffers created with
+// glBufferStorage and mapped once (persistent, coherent), each carved up by a
+// RangeAllocator. Meshes are written straight into the mapped memory, from
+// any thread, and drawn with a base vertex. Each block has its own VAO with
+// the packed vertex attribute and the shared quad index buffer.
+//
+// A freed range may still be read by frames the GPU has not finished, so
+// Free only queues it; EndFrame fences the frame's frees and the ranges are
+// reused once the fence has signaled.
+class VertexArena {
+    public:
+        // GL thread; blocks are allocated as needed, block_size bytes each
+        VertexArena(size_t block_size = size_t(64) << 20) : block_size(block_size) {}
+
+        ~VertexArena()
+        {
+            for (auto &block : blocks) {
+                glDeleteVertexArrays(1, &block->VAO);
+                glDeleteBuffers(1, &block->VBO);
+            }
+            for (auto &retired : retired_frames)
+                glDeleteSync(retired.fence);
+        }
+
+        // Any thread: a range in an existing block, or an invalid range if
+        // none has room (only the GL thread can add blocks, see Allocate)
+        ArenaRange TryAllocate(size_t bytes)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int i = 0; i < static_cast<int>(blocks.size()); i++) {
+                size_t offset = blocks[i]->allocator.Allocate(bytes);
+                if (offset != RangeAllocator::NONE)
+                    return ArenaRange{ i, offset, bytes };
+            }
+            return ArenaRange();
+        }
+
+        // GL thread: like TryAllocate, adding a block when none has room
+        ArenaRange Allocate(size_t bytes)
+        {
+            ArenaRange range = TryAllocate(bytes);
+            if (range.Valid())
+                return range;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            AddBlock(std::max(block_size, bytes));
+            int block = static_cast<int>(blocks.size()) - 1;
+            return ArenaRange{ block, blocks[block]->allocator.Allocate(bytes), bytes };
+        }
+
+        // Any thread: copy data into a range
+        void Write(const ArenaRange &range, const void *data, size_t bytes)
+        {
+            uint8_t *mapped;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                mapped = blocks[range.block]->mapped;
+            }
+            memcpy(mapped + range.offset, data, bytes);
+        }
+
+        // Any thread: give back a range that was never drawn
+        void Discard(const ArenaRange &range)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            blocks[range.block]->allocator.Free(range.offset, range.size);
+        }
+
+        // GL thread: give back a range once the frames drawing it are done
+        void Free(const ArenaRange &range)
+        {
+            freed_this_frame.push_back(range);
+        }
+
+        // GL thread, after the frame's draw calls: fence this frame's frees
+        // and recycle the ranges of earlier frames the GPU has finished
+        void EndFrame()
+        {
+            if (!freed_this_frame.empty()) {
+                retired_frames.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::move(freed_this_frame) });
+                freed_this_frame.clear();
+            }
+
+            while (!retired_frames.empty()) {
+                Retired &retired = retired_frames.front();
+                GLenum status = glClientWaitSync(retired.fence, 0, 0);
+                if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                    break;
+
+                glDeleteSync(retired.fence);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    for (const ArenaRange &range : retired.ranges)
+                        blocks[range.block]->allocator.Free(range.offset, range.size);
+                }
+                retired_frames.pop_front();
+            }
+        }
+
+        // GL thread: bind the VAO of a block for drawing
+        void Bind(int block)
+        {
+            glBindVertexArray(blocks[block]->VAO);
+        }
+
+        size_t Capacity()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            size_t capacity = 0;
+            for (auto &block : blocks)
+                capacity += block->allocator.Capacity();
+            return capacity;
+        }
+
+        size_t Used()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            size_t used = 0;
+            for (auto &block : blocks)
+                used += block->allocator.Used();
+            return used;
+        }
+
+    private:
+        struct Block {
+            unsigned int VBO, VAO;
+            uint8_t *mapped;
+            RangeAllocator allocator;
+        };
+
+        struct Retired {
+            GLsync fence;
+            std::vector<ArenaRange> ranges;
+        };
+
+        // mutex held
+        void AddBlock(size_t size)
+        {
+            std::unique_ptr<Block> block(new Block());
+            block->allocator = RangeAllocator(size, 16);
+
+            glGenVertexArrays(1, &block->VAO);
+            glGenBuffers(1, &block->VBO);
+            glBindVertexArray(block->VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, block->VBO);
+
+            // Immutable storage, mapped for writing for the buffer's lifetime
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+            block->mapped = static_cast<uint8_t*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+
+            // Packed vertex attribute (decoded in the vertex shader)
+            glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+            glEnableVertexAttribArray(0);
+            QuadIndexBuffer::Bind(0);
+
+            blocks.push_back(std::move(block));
+        }
+
+        size_t block_size;
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Block>> blocks;
+
+        // GL thread only
+        std::vector<ArenaRange> freed_this_frame;
+        std::deque<Retired> retired_frames;
+};
+
+#endif
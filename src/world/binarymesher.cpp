@@ -0,0 +1,125 @@
+#include <world/binarymesher.h>
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define PADDED_SIZE (CHUNK_SIZE + 2)
+#define padded_index(x, y, z) static_cast<int>((x + 1) + (y + 1) * PADDED_SIZE + (z + 1) * PADDED_SIZE * PADDED_SIZE)
+
+// Axis each Direction points along, and whether it points towards -axis
+static const int DIRECTION_AXES[6] = { 2, 2, 0, 0, 1, 1 };
+static const bool DIRECTION_NEGATIVE[6] = { true, false, true, false, true, false };
+
+// Non-air bits of one 32-block row along x
+static inline uint32_t RowMask(const uint8_t *row) {
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t lo = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)row), zero));
+    uint32_t hi = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(row + 16)), zero));
+    return ~(lo | (hi << 16));
+#else
+    uint32_t mask = 0;
+    for(int x = 0; x < CHUNK_SIZE; x++)
+        mask |= uint32_t(row[x] != 0) << x;
+    return mask;
+#endif
+}
+
+// In-place transpose of a 32x32 bit matrix (bit c of row r <-> bit r of row c)
+static void Transpose32(uint32_t m[32]) {
+    uint32_t mask = 0x0000FFFF;
+    for(int j = 16; j != 0; j >>= 1, mask ^= mask << j){
+        for(int k = 0; k < 32; k = ((k | j) + 1) & ~j){
+            uint32_t t = ((m[k] >> j) ^ m[k | j]) & mask;
+            m[k] ^= t << j;
+            m[k | j] ^= t;
+        }
+    }
+}
+
+void BinaryMesher::Load(const uint8_t *padded) {
+    // rows[z][y] holds the x bits of each row; the y and z columns are the
+    // same bits transposed
+    uint32_t rows[CHUNK_SIZE][CHUNK_SIZE];
+    for(int z = 0; z < CHUNK_SIZE; z++)
+    for(int y = 0; y < CHUNK_SIZE; y++)
+        rows[z][y] = RowMask(&padded[padded_index(0, y, z)]);
+
+    uint32_t matrix[CHUNK_SIZE];
+    for(int z = 0; z < CHUNK_SIZE; z++){
+        // x columns: columns[0][y][z]
+        for(int y = 0; y < CHUNK_SIZE; y++)
+            columns[0][y][z] = uint64_t(rows[z][y]) << 1;
+
+        // y columns: transpose (y, x) -> (x, y), giving columns[1][z][x]
+        memcpy(matrix, rows[z], sizeof(matrix));
+        Transpose32(matrix);
+        for(int x = 0; x < CHUNK_SIZE; x++)
+            columns[1][z][x] = uint64_t(matrix[x]) << 1;
+    }
+    for(int y = 0; y < CHUNK_SIZE; y++){
+        // z columns: transpose (z, x) -> (x, z), giving columns[2][x][y]
+        for(int z = 0; z < CHUNK_SIZE; z++)
+            matrix[z] = rows[z][y];
+        Transpose32(matrix);
+        for(int x = 0; x < CHUNK_SIZE; x++)
+            columns[2][x][y] = uint64_t(matrix[x]) << 1;
+    }
+
+    // Neighbor layers only matter for the columns crossing them
+    const int layers[2] = { -1, CHUNK_SIZE };
+    for(int l = 0; l < 2; l++){
+        int i = layers[l];
+        for(int a = 0; a < CHUNK_SIZE; a++)
+        for(int b = 0; b < CHUNK_SIZE; b++){
+            if(padded[padded_index(i, a, b)])
+                columns[0][a][b] |= uint64_t(1) << (i + 1);
+            if(padded[padded_index(b, i, a)])
+                columns[1][a][b] |= uint64_t(1) << (i + 1);
+            if(padded[padded_index(a, b, i)])
+                columns[2][a][b] |= uint64_t(1) << (i + 1);
+        }
+    }
+}
+
+void BinaryMesher::BuildFaces(const uint8_t *padded, uint8_t type, bool single_type, uint32_t planes[6][CHUNK_SIZE][CHUNK_SIZE]) {
+    memset(planes, 0, sizeof(uint32_t) * 6 * CHUNK_SIZE * CHUNK_SIZE);
+
+    // Several solid types: faces must also be split by the owning block's type
+    if(!single_type){
+        memset(type_columns, 0, sizeof(type_columns));
+        for(int z = 0; z < CHUNK_SIZE; z++)
+        for(int y = 0; y < CHUNK_SIZE; y++)
+        for(int x = 0; x < CHUNK_SIZE; x++){
+            if(padded[padded_index(x, y, z)] != type)
+                continue;
+            type_columns[0][y][z] |= 1u << x;
+            type_columns[1][z][x] |= 1u << y;
+            type_columns[2][x][y] |= 1u << z;
+        }
+    }
+
+    for(int d = 0; d < 6; d++){
+        int axis = DIRECTION_AXES[d];
+        for(int a = 0; a < CHUNK_SIZE; a++)
+        for(int b = 0; b < CHUNK_SIZE; b++){
+            // A face is exposed where a block is set and the next one along
+            // the direction is not
+            uint64_t column = columns[axis][a][b];
+            uint64_t exposed = DIRECTION_NEGATIVE[d] ? column & ~(column << 1) : column & ~(column >> 1);
+            uint32_t faces = static_cast<uint32_t>(exposed >> 1);
+            if(!single_type)
+                faces &= type_columns[axis][a][b];
+
+            // Scatter into the per-slice planes
+            while(faces){
+                int slice = __builtin_ctz(faces);
+                faces &= faces - 1;
+                planes[d][slice][b] |= 1u << a;
+            }
+        }
+    }
+}
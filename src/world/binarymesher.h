@@ -0,0 +1,36 @@
+#ifndef BINARYMESHER_H
+#define BINARYMESHER_H
+
+#include <cstdint>
+
+#include <world/chunksize.h>
+
+// A column plus its two neighbor bits has to fit a uint64_t, and a face plane
+// row a uint32_t
+static_assert(CHUNK_SIZE == 32, "BinaryMesher assumes 32-block chunk columns");
+
+// Bitmask meshing kernel. Occupancy is stored as one 64-bit column mask per
+// (axis, a, b), with the neighbor layers in bits 0 and CHUNK_SIZE + 1, so the
+// exposed faces of a whole column come out of a shift and an AND-NOT.
+//
+// Axes are x = 0, y = 1, z = 2. For a column along axis, a runs along
+// (axis + 1) % 3 and b along (axis + 2) % 3, the same plane layout the
+// greedy mesher uses.
+class BinaryMesher {
+    public:
+        // Load occupancy (non-air) from a padded (CHUNK_SIZE + 2)^3 snapshot.
+        // Blocks of type are additionally tracked so faces can be split by
+        // type; with a single solid type pass it as the only type.
+        void Load(const uint8_t *padded);
+
+        // Exposed faces of blocks of the given type, per direction (Chunk
+        // Direction order) and slice along the direction's axis: bit a of
+        // planes[d][slice][b] is set when that block face is exposed
+        void BuildFaces(const uint8_t *padded, uint8_t type, bool single_type, uint32_t planes[6][CHUNK_SIZE][CHUNK_SIZE]);
+
+    private:
+        uint64_t columns[3][CHUNK_SIZE][CHUNK_SIZE];
+        uint32_t type_columns[3][CHUNK_SIZE][CHUNK_SIZE];
+};
+
+#endif
@@ -1,74 +1,245 @@
 #include <world/chunk.h>
-#include <FastNoiseLite/FastNoiseLite.h>
+#include <world/binarymesher.h>
+#include <vfx/quadindexbuffer.h>
+
+#include <cstring>
+
+using namespace std;
 
 // Macro for converting 3D coordinates to a 1D index
 #define pos_to_index(x, y, z) static_cast<int>(x + y * CHUNK_SIZE + z * CHUNK_SIZE * CHUNK_SIZE)
 
-// Cube vertices
-float CUBE_VERTS[] = {
-    // Position     // Texture Coords
-    // x,  y,  z,   u, v
-        0, 0, 0,     0, 0, // north face (-z)
-        1, 0, 0,     1, 0,
-        1, 1, 0,     1, 1,
-        0, 1, 0,     0, 1,
-
-        0, 1, 1,     1, 1, // south face (+z)
-        1, 1, 1,     0, 1,
-        1, 0, 1,     0, 0,
-        0, 0, 1,     1, 0, 
-
-        0, 1, 0,     1, 1, // west face (-x)
-        0, 1, 1,     0, 1,
-        0, 0, 1,     0, 0,
-        0, 0, 0,     1, 0, 
-
-        1, 0, 0,     0, 0, // east face (+x)
-        1, 0, 1,     1, 0,
-        1, 1, 1,     1, 1,
-        1, 1, 0,     0, 1,
-
-        0, 0, 0,     0, 0, // bottom face (-y)
-        0, 0, 1,     1, 0,
-        1, 0, 1,     1, 1,
-        1, 0, 0,     0, 1,
-
-        
-        1, 1, 0,     0, 1, // top face (+y)
-        1, 1, 1,     1, 1,
-        0, 1, 1,     1, 0,
-        0, 1, 0,     0, 0,
+// Same for the padded meshing snapshot, where -1 and CHUNK_SIZE are the
+// neighbor layers
+#define padded_index(x, y, z) static_cast<int>((x + 1) + (y + 1) * PADDED_SIZE + (z + 1) * PADDED_SIZE * PADDED_SIZE)
+
+// Pack a vertex into the 32-bit layout described in chunk.h
+static inline uint32_t PackVertex(int x, int y, int z, int face, int layer) {
+    return uint32_t(x) | uint32_t(y) << 6 | uint32_t(z) << 12 | uint32_t(face) << 18 | uint32_t(layer) << 21;
+}
+
+// Offset to the adjacent chunk/block in Direction order
+static const glm::ivec3 DIRECTION_OFFSETS[6] = {
+    glm::ivec3( 0,  0, -1), // north
+    glm::ivec3( 0,  0,  1), // south
+    glm::ivec3(-1,  0,  0), // west
+    glm::ivec3( 1,  0,  0), // east
+    glm::ivec3( 0, -1,  0), // bottom
+    glm::ivec3( 0,  1,  0), // top
+};
+
+// Axis (x = 0, y = 1, z = 2) each Direction points along
+static const int DIRECTION_AXES[6] = { 2, 2, 0, 0, 1, 1 };
+
+// Cube vertices (corner positions of each face, in Direction order). UVs are
+// derived from the position in the vertex shader.
+const int CUBE_VERTS[] = {
+    // x,  y,  z
+        0, 0, 0, // north face (-z)
+        1, 0, 0,
+        1, 1, 0,
+        0, 1, 0,
+
+        0, 1, 1, // south face (+z)
+        1, 1, 1,
+        1, 0, 1,
+        0, 0, 1,
+
+        0, 1, 0, // west face (-x)
+        0, 1, 1,
+        0, 0, 1,
+        0, 0, 0,
+
+        1, 0, 0, // east face (+x)
+        1, 0, 1,
+        1, 1, 1,
+        1, 1, 0,
+
+        0, 0, 0, // bottom face (-y)
+        0, 0, 1,
+        1, 0, 1,
+        1, 0, 0,
+
+        1, 1, 0, // top face (+y)
+        1, 1, 1,
+        0, 1, 1,
+        0, 1, 0,
 };
-// Cube indices
-unsigned int CUBE_INDICES[] = { 0,  1,  2,  2,  3,  0 };
 
-Chunk::Chunk(glm::vec3 offset, Shader *shaderProg) : offset(offset), shader(shaderProg) {
+Chunk::MeshMode Chunk::meshMode = Chunk::GREEDY;
+Chunk::MeshKernel Chunk::meshKernel = Chunk::BINARY;
+bool Chunk::keepCpuMesh = false;
+VertexArena *Chunk::vertexArena = nullptr;
+
+Chunk::Chunk(glm::vec3 offset, Shader *shaderProg, const Heightmap &heightmap)
+    : blockData(CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE, BlockType::AIR), offset(offset), shader(shaderProg) {
     // Initialize the chunk
     worldPos = offset * static_cast<float>(CHUNK_SIZE);
+    if(shader)
+        modelUniform = shader->getUniform<glm::mat4>("model");
+
+    // Chunks entirely above or below the column's surface are a single block
+    // type; skip the per-block loop and the index array
+    if(worldPos.y >= heightmap.max_height){
+        blockData.Fill(BlockType::AIR);
+        faceConnections = ALL_FACES_CONNECTED;
+        return;
+    }
+    if(worldPos.y + CHUNK_SIZE - 1 < heightmap.min_height){
+        blockData.Fill(BlockType::DIRT);
+        minSolidY = 0;
+        maxSolidY = CHUNK_SIZE - 1;
+        faceConnections = 0;
+        return;
+    }
 
-    FastNoiseLite noise;
-    noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+    // Generate the block data from the column's surface heights, then pack
+    // it. Air is also collected as one bit mask per row for the face
+    // connectivity.
+    uint8_t blocks[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+    uint32_t air_rows[CHUNK_SIZE * CHUNK_SIZE] = {};
+    for(int z = 0; z < CHUNK_SIZE; z++)
+    for(int y = 0; y < CHUNK_SIZE; y++)
+    for(int x = 0; x < CHUNK_SIZE; x++){
+        if(y + worldPos.y < heightmap.Get(x, z)){
+            blocks[pos_to_index(x, y, z)] = BlockType::DIRT;
+            minSolidY = min(minSolidY, y);
+            maxSolidY = max(maxSolidY, y);
+        }
+        else{
+            blocks[pos_to_index(x, y, z)] = BlockType::AIR;
+            air_rows[y + z * CHUNK_SIZE] |= 1u << x;
+        }
+    }
+    blockData.Assign(blocks);
+    faceConnections = FindFaceConnections(air_rows);
+}
+
+// Bit of the face pair (a, b) in faceConnections: pairs in order (0, 1),
+// (0, 2) .. (0, 5), (1, 2) .. (4, 5)
+int Chunk::ConnectionBit(Direction a, Direction b) {
+    if(a > b)
+        swap(a, b);
+    return a * 6 - a * (a + 1) / 2 + (b - a - 1);
+}
 
-    // Generate the block data
-    for(float x = 0; x < CHUNK_SIZE; x++)
-    for(float y = 0; y < CHUNK_SIZE; y++)
-    for(float z = 0; z < CHUNK_SIZE; z++){
-        float y_noise = noise.GetNoise(x + worldPos.x, z + worldPos.z) * 10.0f;
-        y_noise += pow(2, noise.GetNoise(x + worldPos.x, z + worldPos.z) * 4.0f);
-        if(y+worldPos.y < y_noise)
-            blockData[pos_to_index(x, y, z)] = BlockType::DIRT;
-        else
-            blockData[pos_to_index(x, y, z)] = BlockType::AIR;
+bool Chunk::FacesConnected(Direction a, Direction b) const {
+    return a == b || (faceConnections >> ConnectionBit(a, b)) & 1;
+}
+
+// Union-find root with path halving
+static int FindRoot(vector<int> &parent, int i) {
+    while(parent[i] != i)
+        i = parent[i] = parent[parent[i]];
+    return i;
+}
+
+// Connected air components, built from the runs of air along x in each row
+// rather than block by block. Bit x of air_rows[y + z * CHUNK_SIZE] is the
+// block at (x, y, z). A run joins the component of any run in the row below
+// or behind it that shares an x. All faces one component touches can see
+// each other.
+uint16_t Chunk::FindFaceConnections(const uint32_t *air_rows) {
+    static thread_local vector<uint32_t> runs;
+    static thread_local vector<int> parent;
+    static thread_local vector<uint8_t> faces;
+    int row_start[CHUNK_SIZE * CHUNK_SIZE + 1];
+    runs.clear();
+    parent.clear();
+    faces.clear();
+
+    for(int z = 0; z < CHUNK_SIZE; z++)
+    for(int y = 0; y < CHUNK_SIZE; y++){
+        int row = y + z * CHUNK_SIZE;
+        row_start[row] = static_cast<int>(runs.size());
+
+        uint32_t air = air_rows[row];
+        while(air){
+            // Lowest run of set bits
+            uint32_t run = air ^ (air & (air + (air & (0u - air))));
+            air &= ~run;
+
+            int id = static_cast<int>(runs.size());
+            runs.push_back(run);
+            parent.push_back(id);
+            faces.push_back((run & 1) << WEST | (run >> (CHUNK_SIZE - 1)) << EAST
+                          | (y == 0) << BOTTOM | (y == CHUNK_SIZE - 1) << TOP
+                          | (z == 0) << NORTH | (z == CHUNK_SIZE - 1) << SOUTH);
+
+            // Row y - 1 ends where this row starts, row z - 1 where the one
+            // after it starts. The run joins the first component it touches,
+            // any others are merged into that one.
+            int root = id;
+            auto join = [&](int other) {
+                int other_root = FindRoot(parent, other);
+                if(root == id)
+                    parent[id] = root = other_root;
+                else if(other_root != root)
+                    parent[other_root] = root;
+            };
+            if(y > 0)
+                for(int other = row_start[row - 1]; other < row_start[row]; other++)
+                    if(runs[other] & run)
+                        join(other);
+            if(z > 0)
+                for(int other = row_start[row - CHUNK_SIZE]; other < row_start[row - CHUNK_SIZE + 1]; other++)
+                    if(runs[other] & run)
+                        join(other);
+        }
     }
+
+    // Gather the faces of each component at its root
+    for(int id = 0; id < static_cast<int>(runs.size()); id++){
+        int root = FindRoot(parent, id);
+        if(root != id)
+            faces[root] |= faces[id];
+    }
+
+    uint16_t connections = 0;
+    for(int id = 0; id < static_cast<int>(runs.size()); id++){
+        if(parent[id] != id)
+            continue;
+        for(int a = 0; a < 6; a++)
+        for(int b = a + 1; b < 6; b++)
+            if((faces[id] >> a & 1) && (faces[id] >> b & 1))
+                connections |= 1 << ConnectionBit(static_cast<Direction>(a), static_cast<Direction>(b));
+    }
+    return connections;
 }
 
+// Standalone chunk with its own (uncached) heightmap
+Chunk::Chunk(glm::vec3 offset, Shader *shaderProg, int seed)
+    : Chunk(offset, shaderProg, [&]{
+        Heightmap heightmap;
+        heightmap.Compute(static_cast<int>(offset.x), static_cast<int>(offset.z), seed);
+        return heightmap;
+    }()) {}
+
 Chunk::~Chunk() {
+    // Hand an upload that never happened back to its pool
+    ReleaseMesh(pending_mesh.exchange(nullptr));
+}
 
+void Chunk::ReleaseGL() {
+    if(mesh_range.Valid())
+        vertexArena->Free(mesh_range);
+    mesh_range = ArenaRange();
+    drawIndexCount = 0;
+}
+
+// Blocks and uploaded vertices (GL thread; a mesh still being built or
+// waiting for upload is not counted)
+size_t Chunk::MemoryUsage() {
+    size_t cpu = sizeof(Chunk) + blockData.MemoryUsage() + debug_vertices.capacity() * sizeof(uint32_t);
+    size_t gpu = mesh_range.size;
+    return cpu + gpu;
 }
 
 Chunk::BlockType Chunk::GetBlockData(int x, int y, int z){
+    if (blockData.IsSingleValue())
+        return InBounds(x, y, z) ? static_cast<BlockType>(blockData.SingleValue()) : BlockType::AIR;
     if (InBounds(x, y, z))
-        return blockData[pos_to_index(x, y, z)];
+        return static_cast<BlockType>(blockData.Get(pos_to_index(x, y, z)));
     return BlockType::AIR;
 }
 
@@ -76,134 +247,394 @@ bool Chunk::InBounds(int x, int y, int z) {
     return x >= 0 && x < CHUNK_SIZE && y >= 0 && y < CHUNK_SIZE && z >= 0 && z < CHUNK_SIZE;
 }
 
-void Chunk::Generate() {
+Chunk::Uniformity Chunk::GetUniformity() const {
+    if(!blockData.IsSingleValue())
+        return MIXED;
+    return blockData.SingleValue() == BlockType::AIR ? ALL_AIR : ALL_SOLID;
+}
+
+void Chunk::Generate(const Chunk *const *neighbors, BufferPool<uint32_t> *pool) {
+    // Start a fresh mesh in a scratch buffer; Generate runs again when a
+    // missing neighbor arrives
+    vertices = pool ? pool->Acquire() : vector<uint32_t>();
+    vertices_pool = pool;
+    vertices_min = glm::ivec3(CHUNK_SIZE);
+    vertices_max = glm::ivec3(0);
+    vertexCount = 0;
+
+    uint8_t missing = 0;
+    for(int d = 0; d < 6; d++)
+        if(!neighbors || !neighbors[d])
+            missing |= 1 << d;
+    missingNeighbors = missing;
+
+    Uniformity uniformity = GetUniformity();
+    if(uniformity == ALL_AIR){
+        // Nothing to draw
+        PublishMesh();
+        return;
+    }
+
+    // Snapshot the blocks plus one layer from each neighbor so the inner loop
+    // needs no bounds checks. Missing neighbors (and the unused edges) are air.
+    static thread_local uint8_t padded[PADDED_SIZE * PADDED_SIZE * PADDED_SIZE];
+    memset(padded, BlockType::AIR, sizeof(padded));
+
+    if(uniformity == ALL_SOLID){
+        for(int z = 0; z < CHUNK_SIZE; z++)
+        for(int y = 0; y < CHUNK_SIZE; y++)
+            memset(&padded[padded_index(0, y, z)], blockData.SingleValue(), CHUNK_SIZE);
+    }
+    else{
+        uint8_t blocks[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+        blockData.Unpack(blocks);
+        for(int z = 0; z < CHUNK_SIZE; z++)
+        for(int y = 0; y < CHUNK_SIZE; y++)
+            memcpy(&padded[padded_index(0, y, z)], &blocks[pos_to_index(0, y, z)], CHUNK_SIZE);
+    }
+
+    for(int d = 0; d < 6; d++){
+        if(missing & (1 << d))
+            continue;
+        const Chunk *neighbor = neighbors[d];
+        if(neighbor->GetUniformity() == ALL_AIR)
+            continue;
+
+        // Copy the neighbor's touching layer into our padding
+        int axis = DIRECTION_AXES[d];
+        int a_axis = (axis + 1) % 3, b_axis = (axis + 2) % 3;
+        glm::ivec3 dst, src;
+        dst[axis] = DIRECTION_OFFSETS[d][axis] < 0 ? -1 : CHUNK_SIZE;
+        src[axis] = DIRECTION_OFFSETS[d][axis] < 0 ? CHUNK_SIZE - 1 : 0;
+        for(int a = 0; a < CHUNK_SIZE; a++)
+        for(int b = 0; b < CHUNK_SIZE; b++){
+            dst[a_axis] = src[a_axis] = a;
+            dst[b_axis] = src[b_axis] = b;
+            padded[padded_index(dst.x, dst.y, dst.z)] = neighbor->blockData.Get(pos_to_index(src.x, src.y, src.z));
+        }
+    }
+
+    if(meshKernel == BINARY)
+        MeshBinary(padded);
+    else if(meshMode == GREEDY)
+        MeshGreedy(padded, uniformity == ALL_SOLID);
+    else
+        MeshNaive(padded, uniformity == ALL_SOLID);
+
+    PublishMesh();
+}
+
+// Index step to the adjacent block in the padded snapshot, in Direction order
+static const int PADDED_STEPS[6] = {
+    -PADDED_SIZE * PADDED_SIZE, PADDED_SIZE * PADDED_SIZE,
+    -1, 1,
+    -PADDED_SIZE, PADDED_SIZE,
+};
+
+// One quad per exposed block face
+void Chunk::MeshNaive(const uint8_t *padded, bool shell_only) {
+    if(shell_only){
+        // Only the outer shell can be exposed; skip the interior entirely
+        for(int d = 0; d < 6; d++){
+            int axis = DIRECTION_AXES[d];
+            int a_axis = (axis + 1) % 3, b_axis = (axis + 2) % 3;
+            glm::ivec3 pos;
+            pos[axis] = DIRECTION_OFFSETS[d][axis] < 0 ? 0 : CHUNK_SIZE - 1;
+            for(int a = 0; a < CHUNK_SIZE; a++)
+            for(int b = 0; b < CHUNK_SIZE; b++){
+                pos[a_axis] = a;
+                pos[b_axis] = b;
+                if(padded[padded_index(pos.x, pos.y, pos.z) + PADDED_STEPS[d]] == BlockType::AIR)
+                    AddFace(pos, static_cast<Direction>(d));
+            }
+        }
+        return;
+    }
+
     // Generate the chunk
     for(int x = 0; x < CHUNK_SIZE; x++) {
     for(int y = 0; y < CHUNK_SIZE; y++) {
     for(int z = 0; z < CHUNK_SIZE; z++) {
-        // Get the position of the block (relative to the chunk)
-        glm::vec3 pos = glm::vec3(x, y, z);
+        int index = padded_index(x, y, z);
 
         // Check if the block is solid, and if so, add the faces
-        if(GetBlockData(x, y, z) != BlockType::AIR){
+        if(padded[index] != BlockType::AIR){
+            // Get the position of the block (relative to the chunk)
+            glm::ivec3 pos = glm::ivec3(x, y, z);
+
             // For each face, check adjacent blocks to see if face should be added
-            if(!GetBlockData(x, y, z-1))
-                AddFace(pos, Direction::NORTH);
-            if(!GetBlockData(x, y, z+1))
-                AddFace(pos, Direction::SOUTH);
-            if(!GetBlockData(x-1, y, z))
-                AddFace(pos, Direction::WEST);
-            if(!GetBlockData(x+1, y, z))
-                AddFace(pos, Direction::EAST);
-            if(!GetBlockData(x, y-1, z))
-                AddFace(pos, Direction::BOTTOM);
-            if(!GetBlockData(x, y+1, z))
-                AddFace(pos, Direction::TOP);
+            for(int d = 0; d < 6; d++)
+                if(padded[index + PADDED_STEPS[d]] == BlockType::AIR)
+                    AddFace(pos, static_cast<Direction>(d));
         }
     }}}
-
-    generated = true;
 }
 
-void Chunk::Render() {
-    if(!generated)
-        return;
-
-    if(!ready){
-        // Generate the VAO, VBO, and EBO
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        // Bind the VAO to the GL State Machine
-        glBindVertexArray(VAO);
+// Merge coplanar faces of the same block type into maximal rectangles. Light
+// is per direction, so every face in a slice shares it.
+void Chunk::MeshGreedy(const uint8_t *padded, bool shell_only) {
+    uint8_t mask[CHUNK_SIZE * CHUNK_SIZE];
+
+    for(int d = 0; d < 6; d++){
+        int axis = DIRECTION_AXES[d];
+        int a_axis = (axis + 1) % 3, b_axis = (axis + 2) % 3;
+        int border = DIRECTION_OFFSETS[d][axis] < 0 ? 0 : CHUNK_SIZE - 1;
+
+        for(int slice = 0; slice < CHUNK_SIZE; slice++){
+            if(shell_only && slice != border)
+                continue;
+
+            // Block type of each exposed face in this slice, AIR where none
+            glm::ivec3 pos;
+            pos[axis] = slice;
+            for(int b = 0; b < CHUNK_SIZE; b++)
+            for(int a = 0; a < CHUNK_SIZE; a++){
+                pos[a_axis] = a;
+                pos[b_axis] = b;
+                int index = padded_index(pos.x, pos.y, pos.z);
+                bool exposed = padded[index] != BlockType::AIR && padded[index + PADDED_STEPS[d]] == BlockType::AIR;
+                mask[a + b * CHUNK_SIZE] = exposed ? BlockType(padded[index]) : BlockType::AIR;
+            }
+
+            for(int b = 0; b < CHUNK_SIZE; b++)
+            for(int a = 0; a < CHUNK_SIZE;){
+                uint8_t type = mask[a + b * CHUNK_SIZE];
+                if(type == BlockType::AIR){
+                    a++;
+                    continue;
+                }
+
+                // Grow along a, then along b while the whole row matches
+                int w = 1;
+                while(a + w < CHUNK_SIZE && mask[a + w + b * CHUNK_SIZE] == type)
+                    w++;
+                int h = 1;
+                for(; b + h < CHUNK_SIZE; h++){
+                    bool row = true;
+                    for(int k = 0; k < w && row; k++)
+                        row = mask[a + k + (b + h) * CHUNK_SIZE] == type;
+                    if(!row)
+                        break;
+                }
+
+                for(int j = 0; j < h; j++)
+                    memset(&mask[a + (b + j) * CHUNK_SIZE], BlockType::AIR, w);
+
+                glm::ivec3 size(1);
+                size[a_axis] = w;
+                size[b_axis] = h;
+                pos[a_axis] = a;
+                pos[b_axis] = b;
+                AddQuad(pos, static_cast<Direction>(d), size);
+
+                a += w;
+            }
+        }
+    }
+}
 
-        // Bind the vertex array object
-        glBindVertexArray(VAO);
+// Same output as MeshNaive/MeshGreedy (as a set of quads), using bitmask
+// columns for face culling and bit scans for merging
+void Chunk::MeshBinary(const uint8_t *padded) {
+    static thread_local BinaryMesher mesher;
+    static thread_local uint32_t planes[6][CHUNK_SIZE][CHUNK_SIZE];
+    mesher.Load(padded);
+
+    int solid_types = 0;
+    for(int i = 0; i < blockData.PaletteSize(); i++)
+        solid_types += blockData.PaletteEntry(i) != BlockType::AIR;
+
+    for(int i = 0; i < blockData.PaletteSize(); i++){
+        uint8_t type = blockData.PaletteEntry(i);
+        if(type == BlockType::AIR)
+            continue;
+        mesher.BuildFaces(padded, type, solid_types == 1, planes);
+
+        for(int d = 0; d < 6; d++){
+            int axis = DIRECTION_AXES[d];
+            int a_axis = (axis + 1) % 3, b_axis = (axis + 2) % 3;
+            Direction direction = static_cast<Direction>(d);
+
+            for(int slice = 0; slice < CHUNK_SIZE; slice++){
+                uint32_t *rows = planes[d][slice];
+                glm::ivec3 pos;
+                pos[axis] = slice;
+
+                for(int b = 0; b < CHUNK_SIZE; b++){
+                    pos[b_axis] = b;
+                    while(rows[b]){
+                        int a = __builtin_ctz(rows[b]);
+                        pos[a_axis] = a;
+
+                        if(meshMode == NAIVE){
+                            rows[b] &= rows[b] - 1;
+                            AddFace(pos, direction);
+                            continue;
+                        }
+
+                        // Run of set bits starting at a, then the rows below
+                        // that contain the whole run
+                        uint32_t ones = ~(rows[b] >> a);
+                        int w = ones ? __builtin_ctz(ones) : CHUNK_SIZE - a;
+                        uint32_t run = (w == 32 ? ~0u : (1u << w) - 1) << a;
+                        rows[b] &= ~run;
+                        int h = 1;
+                        while(b + h < CHUNK_SIZE && (rows[b + h] & run) == run){
+                            rows[b + h] &= ~run;
+                            h++;
+                        }
+
+                        glm::ivec3 size(1);
+                        size[a_axis] = w;
+                        size[b_axis] = h;
+                        AddQuad(pos, direction, size);
+                    }
+                }
+            }
+        }
+    }
+}
 
-        // Bind the vertex buffer object
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+vector<uint32_t> Chunk::GetMeshVertices() {
+    PendingMesh *mesh = pending_mesh.load();
+    return mesh ? mesh->vertices : debug_vertices;
+}
 
-        // Bind the element buffer object
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+// Hand the finished mesh to the GL thread
+void Chunk::PublishMesh() {
+    PendingMesh *mesh = new PendingMesh{ move(vertices), vertices_pool, ArenaRange(), vertexCount, vertices_min, vertices_max };
+    vertices = {};
+
+    // Write the mesh into GPU-visible memory here rather than on the GL
+    // thread, as long as an existing arena block has room for it
+    size_t bytes = mesh->vertices.size() * sizeof(uint32_t);
+    if(vertexArena && bytes > 0) {
+        mesh->range = vertexArena->TryAllocate(bytes);
+        if(mesh->range.Valid())
+            vertexArena->Write(mesh->range, mesh->vertices.data(), bytes);
+    }
 
-        // Tell OpenGL how to interpret the vertex data
-        // Position attribute
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+    // The arena has the vertices now; the scratch buffer need not wait in
+    // the upload queue
+    if(mesh->range.Valid() && !keepCpuMesh) {
+        if(mesh->pool)
+            mesh->pool->Release(move(mesh->vertices));
+        mesh->vertices = {};
+    }
 
-        // Texture Coord attribute
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
+    // A mesh that was never uploaded is simply replaced
+    ReleaseMesh(pending_mesh.exchange(mesh));
+    generated = true;
+}
 
-        // Pseudo-lighting attribute
-        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(5 * sizeof(float)));
-        glEnableVertexAttribArray(2);
+// Give a mesh's vertex buffer back to its pool (unless PublishMesh already
+// did), and its arena range if it was never uploaded
+void Chunk::ReleaseMesh(PendingMesh *mesh) {
+    if(!mesh)
+        return;
+    if(mesh->range.Valid() && vertexArena)
+        vertexArena->Discard(mesh->range);
+    if(mesh->pool && mesh->vertices.capacity() > 0)
+        mesh->pool->Release(move(mesh->vertices));
+    delete mesh;
+}
 
-        // Texture layer attribute
-        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(6 * sizeof(float)));
-        glEnableVertexAttribArray(3);
+// Upload a newly published mesh and drop the CPU copy now that the GPU has it
+bool Chunk::UploadPending() {
+    PendingMesh *mesh = pending_mesh.exchange(nullptr);
+    if(!mesh)
+        return false;
+
+    Upload(*mesh);
+    if(keepCpuMesh)
+        debug_vertices = mesh->vertices;
+    ReleaseMesh(mesh);
+    return true;
+}
 
-        ready = true;
-    }
+// Draw the last uploaded mesh (see UploadPending)
+bool Chunk::Render() {
+    // Empty meshes (all air, enclosed) have no arena range or draw call
+    if(drawIndexCount == 0)
+        return false;
 
-    // Bind the vertex array object
-    glBindVertexArray(VAO);
+    // Bind the vertex array object of the arena block holding the mesh
+    vertexArena->Bind(mesh_range.block);
 
     // Shift the chunk to the correct position
     glm::mat4 model = glm::mat4(1.0f);
     model = glm::translate(model, worldPos);
-    shader->setMat4("model", model);
+    shader->set(modelUniform, model);
 
-    // Draw the chunk
-    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+    // Draw the chunk; the shared quad indices start at its first vertex
+    glDrawElementsBaseVertex(GL_TRIANGLES, drawIndexCount, GL_UNSIGNED_INT, 0, static_cast<GLint>(mesh_range.offset / sizeof(uint32_t)));
+    return true;
 }
 
-void Chunk::AddFace(glm::ivec3 pos, Direction direction) {
+// The box around the uploaded mesh, or around the layers holding blocks
+// while there is none to draw
+void Chunk::GetBounds(glm::vec3 &min, glm::vec3 &max) const {
+    if(drawIndexCount > 0){
+        min = worldPos + glm::vec3(meshMin);
+        max = worldPos + glm::vec3(meshMax);
+    }
+    else if(minSolidY <= maxSolidY){
+        min = worldPos + glm::vec3(0, minSolidY, 0);
+        max = worldPos + glm::vec3(CHUNK_SIZE, maxSolidY + 1, CHUNK_SIZE);
+    }
+    else{
+        // All air: an empty box at the chunk's corner
+        min = max = worldPos;
+    }
+}
 
-    float color = 1.0f;
-    // Lighting
-    switch(direction){
-        case TOP:
-            color = 1.0f;
-            break;
-        case NORTH:
-        case SOUTH:
-            color = 0.86f;
-            break;
-        case EAST:
-        case WEST:
-            color = 0.8f;
-            break;
-        case BOTTOM:
-            color = 0.6f;
-    }
-
-    // Vertices
-    int vert_offset = direction * 20;
-    for(int i = 0; i < 4; i++) {
-        float *ptr = &CUBE_VERTS[vert_offset + i * 5];
+void Chunk::AddToBatch(MultiDrawBatch &batch) {
+    if(drawIndexCount == 0)
+        return;
+    batch.Add(mesh_range, drawIndexCount / 6, worldPos);
+}
 
-        // Position
-        vertices.push_back(*ptr++ + pos.x);
-        vertices.push_back(*ptr++ + pos.y);
-        vertices.push_back(*ptr++ + pos.z);
+// Swap in a published mesh (GL thread). The old range is only reused once
+// the frames drawing it have finished (see VertexArena::Free).
+void Chunk::Upload(PendingMesh &mesh) {
+    if(mesh_range.Valid())
+        vertexArena->Free(mesh_range);
+    mesh_range = ArenaRange();
+    drawIndexCount = mesh.vertexCount / 4 * 6;
+    if(drawIndexCount == 0)
+        return;
 
-        // Texture Coords
-        vertices.push_back(*ptr++);
-        vertices.push_back(*ptr);
-        vertices.push_back(color);
-        vertices.push_back(0);
+    // Copy it now if the mesher found no room in the arena
+    if(!mesh.range.Valid()) {
+        size_t bytes = mesh.vertices.size() * sizeof(uint32_t);
+        mesh.range = vertexArena->Allocate(bytes);
+        vertexArena->Write(mesh.range, mesh.vertices.data(), bytes);
     }
+    mesh_range = mesh.range;
+    mesh.range = ArenaRange();
+    meshMin = mesh.min;
+    meshMax = mesh.max;
 
-    // Indices
-    for(int i = 0; i < 6; i++) {
-        indices.push_back(CUBE_INDICES[i] + vertexCount);
+    vertexArena->Bind(mesh_range.block);
+    QuadIndexBuffer::Bind(drawIndexCount / 6);
+}
+
+void Chunk::AddFace(glm::ivec3 pos, Direction direction) {
+    AddQuad(pos, direction, glm::ivec3(1));
+}
+
+void Chunk::AddQuad(glm::ivec3 pos, Direction direction, glm::ivec3 size) {
+    // Vertices (the unit cube corner stretched to the quad size), widening
+    // the mesh extents as they go
+    int vert_offset = direction * 12;
+    for(int i = 0; i < 4; i++) {
+        const int *ptr = &CUBE_VERTS[vert_offset + i * 3];
+        glm::ivec3 corner = glm::ivec3(ptr[0], ptr[1], ptr[2]) * size + pos;
+        vertices_min = glm::min(vertices_min, corner);
+        vertices_max = glm::max(vertices_max, corner);
+        vertices.push_back(PackVertex(corner.x, corner.y, corner.z, direction, 0));
     }
-    
-    // 4 new vertices and 6 new indices
-    indexCount += 6;
+
+    // 4 new vertices; their indices are in the shared QuadIndexBuffer
     vertexCount += 4;
-}
\ No newline at end of file
+}
@@ -2,10 +2,29 @@
 #define CHUNK_H
 
 #include <vector>
+#include <atomic>
 #include <glm/glm.hpp>
 #include <vfx/shader.h>
+#include <world/chunksize.h>
+#include <world/heightmap.h>
+#include <world/palette.h>
+#include <util/bufferpool.h>
+#include <vfx/vertexarena.h>
+#include <vfx/multidrawbatch.h>
 
-#define CHUNK_SIZE 32
+// Side of the padded block snapshot used for meshing (one neighbor layer on
+// each side)
+#define PADDED_SIZE (CHUNK_SIZE + 2)
+
+// Chunk vertices are packed into one 32-bit integer:
+//   bits  0-5   x (chunk-local, 0..CHUNK_SIZE)
+//   bits  6-11  y
+//   bits 12-17  z
+//   bits 18-20  face (Direction); the shader derives the UVs and the face
+//               shading from it
+//   bits 21-28  texture layer
+//   bits 29-31  unused
+// vfx/shaders/3.3.vertex.glsl decodes the same layout.
 
 // Sometimes less is more... just get the damn thing working and then refactor
 // later on.
@@ -17,6 +36,25 @@ class Chunk {
             DIRT,
         };
 
+        // Whether the chunk holds a single block type
+        enum Uniformity {
+            MIXED,
+            ALL_AIR,
+            ALL_SOLID
+        };
+
+        // Which mesher Generate uses
+        enum MeshMode {
+            NAIVE,  // one quad per exposed face
+            GREEDY  // coplanar faces merged into rectangles
+        };
+
+        // How Generate finds exposed faces
+        enum MeshKernel {
+            SCALAR, // per-block neighbor lookups
+            BINARY  // bitmask columns, see BinaryMesher
+        };
+
         enum Direction {
             NORTH,
             SOUTH,
@@ -26,30 +64,125 @@ class Chunk {
             TOP
         };
 
-        Chunk(glm::vec3 offset, Shader *shader);
+        Chunk(glm::vec3 offset, Shader *shader, const Heightmap &heightmap);
+        Chunk(glm::vec3 offset, Shader *shader, int seed = 1337);
         ~Chunk();
 
-        void Generate();
-        void Render();
+        // Give the uploaded mesh back to vertexArena; must run on the GL
+        // thread before the chunk is destroyed
+        void ReleaseGL();
+
+        // Approximate bytes held for this chunk on the CPU and the GPU
+        size_t MemoryUsage();
+
+        // Build the mesh. neighbors holds the six adjacent chunks in Direction
+        // order (nullptr when not loaded); border faces next to a missing
+        // neighbor are emitted and recorded in missingNeighbors. The vertex
+        // buffer comes from pool (if given) and goes back to it once the
+        // vertices are in the vertex arena.
+        void Generate(const Chunk *const *neighbors = nullptr, BufferPool<uint32_t> *pool = nullptr);
+        // Draw the uploaded mesh; returns whether there was anything to draw
+        bool Render();
+
+        // Queue the uploaded mesh in a multi-draw batch instead of drawing it
+        void AddToBatch(MultiDrawBatch &batch);
+
+        // Upload the latest finished mesh, if one is waiting (GL thread).
+        // Returns whether there was one.
+        bool UploadPending();
         void AddFace(glm::ivec3 pos, Direction direction);
+        void AddQuad(glm::ivec3 pos, Direction direction, glm::ivec3 size);
         BlockType GetBlockData(int x, int y, int z);
         bool InBounds(int x, int y, int z);
+        Uniformity GetUniformity() const;
+
+        // World-space box around the chunk's geometry, for culling (GL thread)
+        void GetBounds(glm::vec3 &min, glm::vec3 &max) const;
+        // Whether the uploaded mesh has any faces (GL thread)
+        bool HasFaces() const { return drawIndexCount > 0; }
 
-        BlockType blockData[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+        // Copy of the last finished mesh's vertices (for tools and the bench,
+        // not while the chunk is being rendered). Empty once in the vertex
+        // arena unless keepCpuMesh is set.
+        std::vector<uint32_t> GetMeshVertices();
+
+        // Mesher used by every chunk (greedy by default)
+        static MeshMode meshMode;
+        static MeshKernel meshKernel;
+
+        // Debug: keep a CPU copy of each mesh after it is uploaded
+        static bool keepCpuMesh;
+
+        // Where uploaded meshes live (set on the GL thread before any chunk
+        // is meshed). Without one, meshes stay on the CPU and cannot be drawn.
+        static VertexArena *vertexArena;
+
+        // Paletted block storage, indexed by pos_to_index
+        PalettedContainer blockData;
 
         glm::vec3 offset;
-        int vertexCount = 0, indexCount = 0;
-        bool generated = false;
-        bool ready = false;
+        int vertexCount = 0;
+        std::atomic<bool> generated{false};
+
+        // Bit per Direction whose neighbor was not loaded at the last Generate
+        std::atomic<uint8_t> missingNeighbors{0};
+
+        // Frame the chunk was last drawn in, for LRU eviction (GL thread)
+        unsigned int lastRendered = 0;
+
+        // Lowest and highest chunk-local Y holding a non-air block, set at
+        // generation (minSolidY > maxSolidY when the chunk is all air)
+        int minSolidY = CHUNK_SIZE, maxSolidY = -1;
+
+        // Which of the 15 pairs of faces are joined by a path through air
+        // inside the chunk (bit ConnectionBit(a, b)), found by flood fill
+        // when the blocks are generated. Visibility through the chunk from
+        // one face to another is only possible along such a path.
+        static const uint16_t ALL_FACES_CONNECTED = 0x7FFF;
+        uint16_t faceConnections = ALL_FACES_CONNECTED;
+        static int ConnectionBit(Direction a, Direction b);
+        bool FacesConnected(Direction a, Direction b) const;
 
 
     private:
-        unsigned int VBO, VAO, EBO;
+        void MeshNaive(const uint8_t *padded, bool shell_only);
+        void MeshGreedy(const uint8_t *padded, bool shell_only);
+        void MeshBinary(const uint8_t *padded);
+        static uint16_t FindFaceConnections(const uint32_t *air_rows);
+        // A finished mesh on its way from the mesher to the GL thread. The
+        // mesher copies it into vertexArena itself when there is room and
+        // then gives the vertices back to their pool (unless keepCpuMesh is
+        // set), so only the count travels on.
+        struct PendingMesh {
+            std::vector<uint32_t> vertices;
+            BufferPool<uint32_t> *pool;
+            ArenaRange range;
+            int vertexCount;
+            glm::ivec3 min, max;    // chunk-local extents of the vertices
+        };
+
+        void PublishMesh();
+        void Upload(PendingMesh &mesh);
+        static void ReleaseMesh(PendingMesh *mesh);
+
         glm::vec3 worldPos;
         Shader *shader;
+        Uniform<glm::mat4> modelUniform;
+
+        // Mesh being built by Generate (worker thread) and the chunk-local
+        // extents of its vertices so far
+        std::vector<uint32_t> vertices;
+        glm::ivec3 vertices_min, vertices_max;
+        BufferPool<uint32_t> *vertices_pool = nullptr;
 
-        std::vector<float> vertices;
-        std::vector<unsigned int> indices;
+        // Last finished mesh, swapped in by PublishMesh and taken by
+        // UploadPending on the GL thread without a lock. Only the arena range
+        // and counts stay with the chunk once it is uploaded.
+        std::atomic<PendingMesh*> pending_mesh{nullptr};
+        std::vector<uint32_t> debug_vertices;
+        ArenaRange mesh_range;
+        glm::ivec3 meshMin = glm::ivec3(0), meshMax = glm::ivec3(0);
+        int drawIndexCount = 0;
 };
 
 #endif
\ No newline at end of file
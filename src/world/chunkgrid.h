@@ -0,0 +1,102 @@
+#ifndef CHUNKGRID_H
+#define CHUNKGRID_H
+
+#include <vector>
+#include <utility>
+#include <cstdlib>
+#include <glm/glm.hpp>
+
+// Window of per-chunk slots centred on the player, stored as a toroidal 3D
+// array: chunk (x, y, z) lives at (x mod width, y mod height, z mod width), so
+// a lookup is index arithmetic and moving the window only resets the slots
+// that fall out of it. Not thread-safe; the main thread owns it.
+template <typename T>
+class ChunkGrid {
+    public:
+        ChunkGrid(int radius_xz = 0, int radius_y = 0)
+            : radius_xz(radius_xz), radius_y(radius_y),
+              width(2 * radius_xz + 1), height(2 * radius_y + 1),
+              center(0), slots(width * width * height) {}
+
+        bool Contains(glm::ivec3 pos) const
+        {
+            return abs(pos.x - center.x) <= radius_xz
+                && abs(pos.y - center.y) <= radius_y
+                && abs(pos.z - center.z) <= radius_xz;
+        }
+
+        // Slot of a chunk position, nullptr outside the window
+        T* Find(glm::ivec3 pos)
+        {
+            return Contains(pos) ? &slots[Index(pos)] : nullptr;
+        }
+
+        // Move the window; evict(pos, slot) is called for every slot that
+        // leaves it before the slot is reset for its new position
+        template <typename F>
+        void Recenter(glm::ivec3 new_center, F evict)
+        {
+            glm::ivec3 old_center = center;
+            for (int i = 0; i < static_cast<int>(slots.size()); i++) {
+                glm::ivec3 old_pos = Position(i, old_center);
+                if (old_pos == Position(i, new_center))
+                    continue;
+                evict(old_pos, slots[i]);
+                slots[i] = T();
+            }
+            center = new_center;
+        }
+
+        // Change the window size, keeping the slots still inside it
+        template <typename F>
+        void Resize(int new_radius_xz, int new_radius_y, F evict)
+        {
+            ChunkGrid resized(new_radius_xz, new_radius_y);
+            resized.center = center;
+            for (int i = 0; i < static_cast<int>(slots.size()); i++) {
+                glm::ivec3 pos = Position(i, center);
+                if (resized.Contains(pos))
+                    resized.slots[resized.Index(pos)] = std::move(slots[i]);
+                else
+                    evict(pos, slots[i]);
+            }
+            *this = std::move(resized);
+        }
+
+        // Call f(pos, slot) for every slot in the window
+        template <typename F>
+        void ForEach(F f)
+        {
+            for (int i = 0; i < static_cast<int>(slots.size()); i++)
+                f(Position(i, center), slots[i]);
+        }
+
+        glm::ivec3 Center() const { return center; }
+
+    private:
+        static int Wrap(int value, int size)
+        {
+            int wrapped = value % size;
+            return wrapped < 0 ? wrapped + size : wrapped;
+        }
+
+        int Index(glm::ivec3 pos) const
+        {
+            return Wrap(pos.x, width) + Wrap(pos.y, height) * width + Wrap(pos.z, width) * width * height;
+        }
+
+        // The one position in the window around c that maps to slot i
+        glm::ivec3 Position(int i, glm::ivec3 c) const
+        {
+            glm::ivec3 index(i % width, (i / width) % height, i / (width * height));
+            glm::ivec3 low(c.x - radius_xz, c.y - radius_y, c.z - radius_xz);
+            return low + glm::ivec3(Wrap(index.x - low.x, width), Wrap(index.y - low.y, height), Wrap(index.z - low.z, width));
+        }
+
+        int radius_xz, radius_y;
+        int width, height;
+        glm::ivec3 center;
+        std::vector<T> slots;
+};
+
+#endif
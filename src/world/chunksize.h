@@ -0,0 +1,8 @@
+#ifndef CHUNKSIZE_H
+#define CHUNKSIZE_H
+
+// Side of a chunk in blocks. Chunks, column heightmaps and the binary mesher
+// all size their arrays from this one definition.
+#define CHUNK_SIZE 32
+
+#endif
@@ -0,0 +1,61 @@
+#include <world/heightmap.h>
+#include <util/simdnoise.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+void Heightmap::Compute(int chunk_x, int chunk_z, int seed) {
+    float world_x = static_cast<float>(chunk_x * CHUNK_SIZE);
+    float world_z = static_cast<float>(chunk_z * CHUNK_SIZE);
+
+    // One noise sample per column instead of one per block, filled in one batch
+    float noise[CHUNK_SIZE * CHUNK_SIZE];
+    SimdNoise(seed).FillGrid2D(world_x, world_z, CHUNK_SIZE, CHUNK_SIZE, noise);
+
+    min_height = INFINITY;
+    max_height = -INFINITY;
+    for(int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; i++){
+        float height = noise[i] * 10.0f;
+        height += pow(2, noise[i] * 4.0f);
+        heights[i] = height;
+        min_height = min(min_height, height);
+        max_height = max(max_height, height);
+    }
+}
+
+HeightmapCache::HeightmapCache(int seed) : seed(seed) {}
+
+shared_ptr<const Heightmap> HeightmapCache::Get(int chunk_x, int chunk_z) {
+    auto key = make_tuple(chunk_x, chunk_z);
+    {
+        lock_guard<mutex> lock(columns_mutex);
+        auto it = columns.find(key);
+        if (it != columns.end())
+            return it->second;
+    }
+
+    // Compute outside the lock; if another thread got there first keep theirs
+    auto heightmap = make_shared<Heightmap>();
+    heightmap->Compute(chunk_x, chunk_z, seed);
+
+    lock_guard<mutex> lock(columns_mutex);
+    return columns.emplace(key, heightmap).first->second;
+}
+
+void HeightmapCache::EvictOutside(int center_x, int center_z, int radius) {
+    lock_guard<mutex> lock(columns_mutex);
+    for (auto it = columns.begin(); it != columns.end();) {
+        if (abs(get<0>(it->first) - center_x) > radius || abs(get<1>(it->first) - center_z) > radius)
+            it = columns.erase(it);
+        else
+            ++it;
+    }
+}
+
+size_t HeightmapCache::Size() {
+    lock_guard<mutex> lock(columns_mutex);
+    return columns.size();
+}
@@ -0,0 +1,44 @@
+#ifndef HEIGHTMAP_H
+#define HEIGHTMAP_H
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <util/hashtuple.h>
+#include <world/chunksize.h>
+
+// Terrain surface heights for one chunk column (32x32 blocks), shared by every
+// chunk stacked vertically in that column
+struct Heightmap {
+    float heights[CHUNK_SIZE * CHUNK_SIZE];
+    float min_height, max_height;
+
+    float Get(int x, int z) const { return heights[x + z * CHUNK_SIZE]; }
+
+    // Fill the heightmap for the given chunk column
+    void Compute(int chunk_x, int chunk_z, int seed);
+};
+
+// Column heightmap service keyed by (chunk_x, chunk_z). Heights are computed
+// once per column and handed out to every vertical chunk in it.
+class HeightmapCache {
+    public:
+        HeightmapCache(int seed = 1337);
+
+        // Returns the heightmap for the column, computing it on first use
+        std::shared_ptr<const Heightmap> Get(int chunk_x, int chunk_z);
+
+        // Drop every column further than radius chunks from the center
+        // column (chunks still holding one keep it alive)
+        void EvictOutside(int center_x, int center_z, int radius);
+
+        size_t Size();
+
+    private:
+        std::unordered_map<std::tuple<int, int>, std::shared_ptr<const Heightmap>> columns;
+        std::mutex columns_mutex;
+        int seed;
+};
+
+#endif
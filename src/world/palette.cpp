@@ -0,0 +1,130 @@
+#include <world/palette.h>
+
+#include <cstring>
+
+using namespace std;
+
+PalettedContainer::PalettedContainer(int size, uint8_t value) : size(size) {
+    palette.push_back(value);
+}
+
+int PalettedContainer::IndexOf(uint8_t value) const {
+    for (size_t i = 0; i < palette.size(); i++)
+        if (palette[i] == value)
+            return static_cast<int>(i);
+    return -1;
+}
+
+void PalettedContainer::SetIndex(int index, uint64_t palette_index) {
+    int shift = (index & per_word_mask) << bits_log2;
+    uint64_t &word = data[index >> per_word_log2];
+    word = (word & ~(value_mask << shift)) | (palette_index << shift);
+}
+
+// Repack the indices with a new width (a power of two, or 0 for single value)
+void PalettedContainer::Resize(int new_bits) {
+    vector<uint64_t> old_data;
+    old_data.swap(data);
+    int old_bits = bits, old_bits_log2 = bits_log2;
+    int old_per_word_log2 = per_word_log2, old_per_word_mask = per_word_mask;
+    uint64_t old_mask = value_mask;
+
+    bits = new_bits;
+    if (bits == 0) {
+        bits_log2 = per_word_log2 = per_word_mask = 0;
+        value_mask = 0;
+        return;
+    }
+
+    bits_log2 = 0;
+    while ((1 << bits_log2) < bits)
+        bits_log2++;
+    per_word_log2 = 6 - bits_log2;
+    per_word_mask = (1 << per_word_log2) - 1;
+    value_mask = (uint64_t(1) << bits) - 1;
+    data.assign((size + per_word_mask) >> per_word_log2, 0);
+
+    // Single value containers implicitly hold index 0 everywhere
+    if (old_bits == 0)
+        return;
+
+    for (int i = 0; i < size; i++) {
+        int shift = (i & old_per_word_mask) << old_bits_log2;
+        SetIndex(i, (old_data[i >> old_per_word_log2] >> shift) & old_mask);
+    }
+}
+
+void PalettedContainer::Set(int index, uint8_t value) {
+    int palette_index = IndexOf(value);
+    if (palette_index < 0) {
+        palette_index = static_cast<int>(palette.size());
+        palette.push_back(value);
+
+        // Grow the index width once the palette no longer fits
+        if (palette.size() > (size_t(1) << bits))
+            Resize(bits == 0 ? 1 : bits * 2);
+    }
+
+    if (bits != 0)
+        SetIndex(index, palette_index);
+}
+
+void PalettedContainer::Assign(const uint8_t *values) {
+    // Build the palette first so the index width is only picked once
+    bool present[256] = {};
+    palette.clear();
+    for (int i = 0; i < size; i++) {
+        if (!present[values[i]]) {
+            present[values[i]] = true;
+            palette.push_back(values[i]);
+        }
+    }
+
+    int new_bits = 0;
+    while ((size_t(1) << new_bits) < palette.size())
+        new_bits = new_bits == 0 ? 1 : new_bits * 2;
+    data.clear();
+    bits = 0;
+    Resize(new_bits);
+    if (bits == 0)
+        return;
+
+    uint8_t lookup[256];
+    for (size_t i = 0; i < palette.size(); i++)
+        lookup[palette[i]] = static_cast<uint8_t>(i);
+
+    int per_word = 1 << per_word_log2;
+    for (size_t w = 0; w < data.size(); w++) {
+        uint64_t word = 0;
+        int base = static_cast<int>(w) << per_word_log2;
+        for (int k = 0; k < per_word && base + k < size; k++)
+            word |= uint64_t(lookup[values[base + k]]) << (k << bits_log2);
+        data[w] = word;
+    }
+}
+
+void PalettedContainer::Fill(uint8_t value) {
+    palette.assign(1, value);
+    data.clear();
+    bits = 0;
+    Resize(0);
+}
+
+void PalettedContainer::Unpack(uint8_t *out) const {
+    if (bits == 0) {
+        memset(out, palette[0], size);
+        return;
+    }
+
+    int per_word = 1 << per_word_log2;
+    for (size_t w = 0; w < data.size(); w++) {
+        uint64_t word = data[w];
+        int base = static_cast<int>(w) << per_word_log2;
+        for (int k = 0; k < per_word && base + k < size; k++, word >>= bits)
+            out[base + k] = palette[word & value_mask];
+    }
+}
+
+size_t PalettedContainer::MemoryUsage() const {
+    return palette.capacity() * sizeof(uint8_t) + data.capacity() * sizeof(uint64_t);
+}
@@ -0,0 +1,57 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Paletted block storage. Values are stored as indices into a small local
+// palette, bit-packed into 64-bit words. The index width grows (1, 2, 4, 8 bits)
+// as new values are added, and a container holding a single value keeps no
+// index array at all.
+class PalettedContainer {
+    public:
+        PalettedContainer(int size, uint8_t value = 0);
+
+        uint8_t Get(int index) const {
+            if (bits == 0)
+                return palette[0];
+            int shift = (index & per_word_mask) << bits_log2;
+            return palette[(data[index >> per_word_log2] >> shift) & value_mask];
+        }
+
+        void Set(int index, uint8_t value);
+
+        // Replace the whole contents from a flat array of size values
+        void Assign(const uint8_t *values);
+
+        // Set every value, collapsing to a single value
+        void Fill(uint8_t value);
+
+        // Decode the whole contents into a flat array of size values
+        void Unpack(uint8_t *out) const;
+
+        bool IsSingleValue() const { return bits == 0; }
+        uint8_t SingleValue() const { return palette[0]; }
+        int PaletteSize() const { return static_cast<int>(palette.size()); }
+        uint8_t PaletteEntry(int i) const { return palette[i]; }
+        int BitsPerIndex() const { return bits; }
+        int Size() const { return size; }
+
+        // Heap memory held by the palette and index array
+        size_t MemoryUsage() const;
+
+    private:
+        int IndexOf(uint8_t value) const;
+        void Resize(int new_bits);
+        void SetIndex(int index, uint64_t palette_index);
+
+        int size;
+        int bits = 0, bits_log2 = 0;
+        int per_word_log2 = 0, per_word_mask = 0;
+        uint64_t value_mask = 0;
+        std::vector<uint8_t> palette;
+        std::vector<uint64_t> data;
+};
+
+#endif
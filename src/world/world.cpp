@@ -1,100 +1,589 @@
 #include <world/world.h>
 #include <iostream>
+#include <algorithm>
+#include <chrono>
 
 using namespace std;
 
 World *World::world = nullptr;
 
-World::World(Shader *shader) : shader(shader), running(true) {
-    chunk_thread = thread(&World::GenerateChunks, this);
+World::World(Shader *shader, int threads) : draw_batch(shader), shader(shader) {
+    grid = ChunkGrid<ChunkSlot>(render_distance + UNLOAD_HYSTERESIS, render_height + UNLOAD_HYSTERESIS);
+    vertex_arena.reset(new VertexArena());
+    Chunk::vertexArena = vertex_arena.get();
+    jobs.reset(new ThreadPool(threads));
+    mesh_pools.reset(new BufferPool<uint32_t>[jobs->Size()]);
+    max_loads_in_flight = 2 * jobs->Size();
 }
 
 World::~World() {
-    running = false;
-    if (chunk_thread.joinable()) {
-        chunk_thread.join();
+    // Stop the workers before the state their jobs use goes away
+    jobs.reset();
+
+    grid.ForEach([this](glm::ivec3, ChunkSlot &slot) { EvictSlot(slot); });
+    for (auto &chunk : unloaded_chunks)
+        chunk->ReleaseGL();
+    unloaded_chunks.clear();
+    render_list.clear();
+    upload_queue.clear();
+    completed.Drain([](Completion&) {});
+
+    Chunk::vertexArena = nullptr;
+    vertex_arena.reset();
+}
+
+// Offset to each neighbor in Chunk::Direction order
+static const glm::ivec3 NEIGHBOR_OFFSETS[6] = {
+    glm::ivec3(0, 0, -1), glm::ivec3(0, 0, 1),
+    glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0),
+    glm::ivec3(0, -1, 0), glm::ivec3(0, 1, 0),
+};
+
+// Job: build the blocks of a chunk and hand it to the main thread, unless
+// the player has moved away in the meantime
+void World::LoadChunk(glm::ivec3 chunk_pos, CancelToken token){
+    // Load the chunk
+    shared_ptr<Chunk> chunk;
+    if (!token.Cancelled()) {
+        shared_ptr<const Heightmap> heightmap = heightmaps.Get(chunk_pos.x, chunk_pos.z);
+        chunk = make_shared<Chunk>(chunk_pos, shader, *heightmap);
+    }
+
+    completed.Push({ chunk_pos, token.Cancelled() ? nullptr : chunk, token, false, 0 });
+}
+
+// Mesh a chunk on the job system against whichever of its neighbors are
+// loaded now. The job holds references to all of them, so they stay alive if
+// they are unloaded meanwhile; it is skipped if the chunk is unloaded before
+// it starts.
+void World::SubmitMesh(glm::ivec3 chunk_pos, ChunkSlot &slot) {
+    shared_ptr<Chunk> chunk = slot.chunk;
+    CancelToken token = slot.meshToken;
+    shared_ptr<Chunk> neighbors[6];
+    for (int d = 0; d < 6; d++) {
+        ChunkSlot *neighbor = grid.Find(chunk_pos + NEIGHBOR_OFFSETS[d]);
+        if (neighbor)
+            neighbors[d] = neighbor->chunk;
+    }
+    slot.meshing = true;
+    slot.meshStale = false;
+
+    jobs->Submit([this, chunk_pos, chunk, neighbors, token]{
+        if (token.Cancelled()) {
+            completed.Push({ chunk_pos, nullptr, token, true, 0 });
+            return;
+        }
+
+        const Chunk *loaded[6];
+        for (int d = 0; d < 6; d++)
+            loaded[d] = neighbors[d].get();
+
+        int worker = ThreadPool::WorkerIndex();
+        chunk->Generate(loaded, worker >= 0 ? &mesh_pools[worker] : nullptr);
+
+        completed.Push({ chunk_pos, chunk, token, true, chunk->vertexCount * sizeof(uint32_t) });
+    });
+}
+
+// Put a freshly loaded chunk into its slot and mesh it
+void World::InsertChunk(glm::ivec3 chunk_pos, ChunkSlot &slot, shared_ptr<Chunk> chunk) {
+    slot.state = ChunkSlot::RESIDENT;
+    slot.chunk = chunk;
+    num_chunks++;
+    SubmitMesh(chunk_pos, slot);
+
+    if (InRange(chunk_pos.x, chunk_pos.y, chunk_pos.z, last_chunk_x, last_chunk_y, last_chunk_z, 0))
+        render_list.push_back(chunk);
+
+    // Neighbors meshed without this chunk drew walls along the shared
+    // border; mesh them again (an all-air chunk changes nothing). A mesh
+    // still running was started without us, so it is repeated when it ends.
+    if (chunk->GetUniformity() == Chunk::ALL_AIR)
+        return;
+    for (int d = 0; d < 6; d++) {
+        glm::ivec3 pos = chunk_pos + NEIGHBOR_OFFSETS[d];
+        ChunkSlot *neighbor = grid.Find(pos);
+        if (!neighbor || neighbor->state != ChunkSlot::RESIDENT)
+            continue;
+        // Direction d ^ 1 is the opposite side, pointing back at us
+        if (neighbor->meshing)
+            neighbor->meshStale = true;
+        else if (neighbor->chunk->missingNeighbors & (1 << (d ^ 1)))
+            SubmitMesh(pos, *neighbor);
+    }
+}
+
+// Take in the loads and meshes the workers finished since the last frame
+void World::ProcessCompleted() {
+    completed.Drain([this](Completion &completion) {
+        ChunkSlot *slot = grid.Find(completion.pos);
+
+        if (completion.meshed) {
+            // Skipped jobs are only counted, and meshes of chunks that have
+            // been unloaded since are ignored
+            if (!completion.chunk) {
+                num_meshes_cancelled++;
+                return;
+            }
+            if (!slot || slot->chunk != completion.chunk)
+                return;
+            slot->meshing = false;
+            upload_queue.push_back({ completion.pos, completion.chunk, completion.bytes });
+            upload_bytes_pending += completion.bytes;
+            if (slot->meshStale)
+                SubmitMesh(completion.pos, *slot);
+            return;
+        }
+
+        loads_in_flight--;
+        if (completion.token.Cancelled() || !completion.chunk) {
+            num_loads_cancelled++;
+            return;
+        }
+        if (slot && slot->state == ChunkSlot::LOADING)
+            InsertChunk(completion.pos, *slot, completion.chunk);
+    });
+}
+
+// Upload finished meshes, oldest first, until this frame's byte or time
+// budget is used up
+void World::ProcessUploads() {
+    auto start = chrono::steady_clock::now();
+    num_uploads_last_frame = 0;
+    upload_bytes_last_frame = 0;
+
+    while (!upload_queue.empty()) {
+        PendingUpload &upload = upload_queue.front();
+        if (num_uploads_last_frame > 0) {
+            chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+            if (upload_bytes_last_frame + upload.bytes > upload_bytes_per_frame || elapsed.count() > upload_ms_per_frame)
+                break;
+        }
+
+        // Chunks unloaded since they were meshed are skipped
+        ChunkSlot *slot = grid.Find(upload.pos);
+        if (slot && slot->chunk == upload.chunk && upload.chunk->UploadPending()) {
+            slot->uploaded = true;
+            num_uploads_last_frame++;
+            upload_bytes_last_frame += upload.bytes;
+        }
+        upload_bytes_pending -= upload.bytes;
+        upload_queue.pop_front();
+    }
+    num_uploads_pending = upload_queue.size();
+}
+
+// Forget a slot: cancel its load, or unload its chunk and cancel the mesh
+// jobs that have not started
+void World::EvictSlot(ChunkSlot &slot) {
+    if (slot.state == ChunkSlot::LOADING)
+        slot.token.Cancel();
+    if (slot.chunk) {
+        slot.meshToken.Cancel();
+        unloaded_chunks.push_back(move(slot.chunk));
+        num_chunks--;
     }
+    slot = ChunkSlot();
+}
+
+// Lower loads first: distance from the player in chunks, up to three times
+// as far for chunks straight behind the view direction
+float World::LoadPriority(glm::ivec3 chunk_pos) const {
+    glm::vec3 delta = glm::vec3(chunk_pos) + glm::vec3(0.5f) - priority_pos;
+    float distance = glm::length(delta);
+    float facing = distance > 0.0f ? glm::dot(delta, priority_view) / distance : 1.0f;
+    return distance * (2.0f - facing);
 }
 
-void World::GenerateChunks(){
-    while (running){
-        unique_lock<mutex> lock(chunk_mutex);
-        if(!chunk_queue.empty()){
-            glm::ivec3 chunk_pos = chunk_queue.front();
-            auto chunk_key = make_tuple(chunk_pos.x, chunk_pos.y, chunk_pos.z);
-            chunk_queue.pop();
-            chunks_to_render.erase(chunk_key);
-            lock.unlock();
+// Heap order for load_queue
+bool World::LoadBefore(const LoadRequest &a, const LoadRequest &b) {
+    return a.priority > b.priority;
+}
+
+// Queue an empty slot's position for loading, by priority
+void World::QueueLoad(glm::ivec3 chunk_pos, ChunkSlot &slot) {
+    slot.state = ChunkSlot::QUEUED;
+    load_queue.push_back({ LoadPriority(chunk_pos), chunk_pos });
+    push_heap(load_queue.begin(), load_queue.end(), LoadBefore);
+}
 
-            // Load the chunk
-            Chunk *chunk = new Chunk(chunk_pos, shader);
-            chunk->Generate();
+// Hand the most urgent chunks to the job system while there is room
+void World::SubmitLoads() {
+    while (!load_queue.empty() && loads_in_flight < max_loads_in_flight) {
+        pop_heap(load_queue.begin(), load_queue.end(), LoadBefore);
+        glm::ivec3 chunk_pos = load_queue.back().pos;
+        load_queue.pop_back();
 
-            lock.lock();
-            if (chunks.find(chunk_key) == chunks.end()) {
-                chunks[chunk_key] = chunk;
+        ChunkSlot *slot = grid.Find(chunk_pos);
+        if (!slot || slot->state != ChunkSlot::QUEUED)
+            continue;
+
+        CancelToken token;
+        slot->state = ChunkSlot::LOADING;
+        slot->token = token;
+        loads_in_flight++;
+        jobs->Submit([this, chunk_pos, token]{ LoadChunk(chunk_pos, token); });
+    }
+}
+
+// Drop queued loads and cancel running ones that are now further than the
+// render distance (plus LOAD_HYSTERESIS) from the player's chunk
+void World::CancelLoadsOutside(int chunk_x, int chunk_y, int chunk_z) {
+    auto outside = [&](glm::ivec3 pos) {
+        return !InRange(pos.x, pos.y, pos.z, chunk_x, chunk_y, chunk_z, LOAD_HYSTERESIS);
+    };
+
+    size_t kept = 0;
+    for (const LoadRequest &request : load_queue) {
+        if (outside(request.pos)) {
+            ChunkSlot *slot = grid.Find(request.pos);
+            if (slot && slot->state == ChunkSlot::QUEUED) {
+                *slot = ChunkSlot();
+                num_loads_cancelled++;
             }
-            lock.unlock();
         } else {
-            lock.unlock();
-            this_thread::sleep_for(chrono::milliseconds(10));
+            load_queue[kept++] = request;
         }
     }
+    load_queue.resize(kept);
+    make_heap(load_queue.begin(), load_queue.end(), LoadBefore);
+
+    // Running jobs see the token and are counted when they report back
+    grid.ForEach([&](glm::ivec3 pos, ChunkSlot &slot) {
+        if (slot.state == ChunkSlot::LOADING && outside(pos)) {
+            slot.token.Cancel();
+            slot = ChunkSlot();
+        }
+    });
 }
 
-Chunk* World::GetChunk(int chunk_x, int chunk_y, int chunk_z) {
-    lock_guard<mutex> lock(chunk_mutex);
-    auto it = chunks.find(std::make_tuple(chunk_x, chunk_y, chunk_z));
-    if (it != chunks.end()) {
-        return it->second;
+// Unload chunks while there are more than max_resident_chunks or they use
+// more than memory_budget bytes: first those kept beyond the render distance,
+// then the least recently drawn ones in range. Chunks drawn this frame, and
+// those whose first mesh is not uploaded yet, are never evicted. An evicted
+// chunk in range leaves render_list with its slot, which waits for the
+// position to come into view before loading it again (see
+// ReloadEvictedInView). A chunk with nothing to draw would be evicted again
+// right after, so its slot stays EVICTED until it leaves the grid.
+void World::EvictChunks() {
+    struct Candidate {
+        bool in_range;
+        unsigned int last_rendered;
+        glm::ivec3 pos;
+    };
+
+    size_t resident = 0, memory = 0;
+    vector<Candidate> candidates;
+    grid.ForEach([&](glm::ivec3 pos, ChunkSlot &slot) {
+        if (slot.state != ChunkSlot::RESIDENT)
+            return;
+        resident++;
+        memory += slot.chunk->MemoryUsage();
+        if (slot.uploaded && slot.chunk->lastRendered != frame) {
+            bool in_range = InRange(pos.x, pos.y, pos.z, last_chunk_x, last_chunk_y, last_chunk_z, 0);
+            candidates.push_back({ in_range, slot.chunk->lastRendered, pos });
+        }
+    });
+    if (resident <= max_resident_chunks && memory <= memory_budget)
+        return;
+
+    sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+        return a.in_range != b.in_range ? b.in_range : a.last_rendered < b.last_rendered;
+    });
+    bool evicted_in_range = false;
+    for (const Candidate &candidate : candidates) {
+        if (resident <= max_resident_chunks && memory <= memory_budget)
+            break;
+        ChunkSlot *slot = grid.Find(candidate.pos);
+        memory -= slot->chunk->MemoryUsage();
+        resident--;
+        EvictedChunk evicted;
+        evicted.pos = candidate.pos;
+        slot->chunk->GetBounds(evicted.min, evicted.max);
+        bool has_faces = slot->chunk->HasFaces();
+        EvictSlot(*slot);
+        num_chunks_evicted++;
+
+        if (candidate.in_range) {
+            slot->state = ChunkSlot::EVICTED;
+            if (has_faces)
+                evicted_chunks.push_back(evicted);
+            evicted_in_range = true;
+        }
+    }
+
+    // Drop the evicted chunks from render_list; only the job system may
+    // still hold them now, so FreeUnloadedChunks can release them
+    if (evicted_in_range) {
+        size_t kept = 0;
+        for (size_t i = 0; i < render_list.size(); i++) {
+            ChunkSlot *slot = grid.Find(glm::ivec3(render_list[i]->offset));
+            if (slot && slot->chunk == render_list[i])
+                render_list[kept++] = move(render_list[i]);
+        }
+        render_list.resize(kept);
+    }
+}
+
+// Queue loads for the evicted chunks in range that would be drawn again:
+// their old bounds are in the frustum and, if the visibility search ran this
+// frame, it reached them. Positions that left the grid or were reset are
+// forgotten.
+void World::ReloadEvictedInView(const Frustum &frustum, bool searched) {
+    size_t kept = 0;
+    for (size_t i = 0; i < evicted_chunks.size(); i++) {
+        const EvictedChunk &evicted = evicted_chunks[i];
+        ChunkSlot *slot = grid.Find(evicted.pos);
+        if (!slot || slot->state != ChunkSlot::EVICTED)
+            continue;
+
+        bool in_view = InRange(evicted.pos.x, evicted.pos.y, evicted.pos.z, last_chunk_x, last_chunk_y, last_chunk_z, 0)
+            && frustum.Intersects(evicted.min, evicted.max)
+            && (!searched || slot->visibleFrame == frame);
+        if (in_view)
+            QueueLoad(evicted.pos, *slot);
+        else
+            evicted_chunks[kept++] = evicted;
+    }
+    evicted_chunks.resize(kept);
+}
+
+size_t World::MemoryUsage() {
+    size_t memory = 0;
+    grid.ForEach([&](glm::ivec3, ChunkSlot &slot) {
+        if (slot.state == ChunkSlot::RESIDENT)
+            memory += slot.chunk->MemoryUsage();
+    });
+    return memory;
+}
+
+// Release the GL objects and memory of unloaded chunks once no job is still
+// meshing them or using them as a neighbor. Nothing can take a new reference
+// after they left the grid, so a use count of one is final.
+void World::FreeUnloadedChunks() {
+    size_t kept = 0;
+    for (size_t i = 0; i < unloaded_chunks.size(); i++) {
+        if (unloaded_chunks[i].use_count() == 1) {
+            unloaded_chunks[i]->ReleaseGL();
+            unloaded_chunks[i].reset();
+        } else {
+            unloaded_chunks[kept++] = move(unloaded_chunks[i]);
+        }
+    }
+    unloaded_chunks.resize(kept);
+}
+
+vector<ThreadPool::WorkerStats> World::GetJobStats() {
+    return jobs->Stats();
+}
+
+shared_ptr<Chunk> World::GetChunk(int chunk_x, int chunk_y, int chunk_z) {
+    ChunkSlot *slot = grid.Find(glm::ivec3(chunk_x, chunk_y, chunk_z));
+    if (slot) {
+        return slot->chunk;
     }
     return nullptr;
 }
 
-void World::Update(glm::vec3 player_pos) {
-    // Get the chunk that the player is in
-    int chunk_x = (int)player_pos.x / CHUNK_SIZE;
-    int chunk_y = (int)player_pos.y / CHUNK_SIZE;
-    int chunk_z = (int)player_pos.z / CHUNK_SIZE;
-
-    // Load the chunks around the player
-    for (int x = -render_distance; x <= render_distance; x++)
-    for (int y = -render_height; y <= render_height; y++)
-    for (int z = -render_distance; z <= render_distance; z++) {
-        // Get the chunk position
-        int new_chunk_x = chunk_x + x;
-        int new_chunk_y = chunk_y + y;
-        int new_chunk_z = chunk_z + z;
-
-        // Create the key
-        tuple<int, int, int> chunk_tup = make_tuple(new_chunk_x, new_chunk_y, new_chunk_z);
-        
-        // Check if the chunk is already loaded
-        bool chunk_loaded = false;
-        {   
-            lock_guard<mutex> lock(chunk_mutex);
-            // Chunk is loaded, set flag
-            if(chunks.find(chunk_tup) != chunks.end())
-                chunk_loaded = true;
-
-            // Chunk is not loaded, add it to the queue
-            else if (chunks_to_render.find(chunk_tup) == chunks_to_render.end()){
-                chunk_queue.push(glm::ivec3(new_chunk_x, new_chunk_y, new_chunk_z));
-                chunks_to_render.insert(chunk_tup);
-                chunks_loading++;
-            }
+void World::SetRenderDistance(int distance, int height) {
+    render_distance = distance;
+    render_height = height;
+    grid.Resize(render_distance + UNLOAD_HYSTERESIS, render_height + UNLOAD_HYSTERESIS,
+                [this](glm::ivec3, ChunkSlot &slot) { EvictSlot(slot); });
+    load_set_dirty = true;
+}
+
+// Whether a chunk position is within the render distance (plus margin) of the
+// given chunk
+bool World::InRange(int x, int y, int z, int chunk_x, int chunk_y, int chunk_z, int margin) const {
+    return abs(x - chunk_x) <= render_distance + margin
+        && abs(y - chunk_y) <= render_height + margin
+        && abs(z - chunk_z) <= render_distance + margin;
+}
+
+// Cave culling: a chunk can only be seen from the camera if some path of
+// chunks leads to it where each chunk connects the face the path enters by to
+// the face it leaves by. The path never turns back towards the camera (so it
+// cannot wrap around a wall) and skips chunks out of view. Chunks that are
+// not loaded are treated as open.
+bool World::FindVisibleChunks(glm::ivec3 start, const Frustum &frustum) {
+    ChunkSlot *start_slot = grid.Find(start);
+    if (!start_slot)
+        return false;
+
+    visibility_queue.clear();
+    start_slot->visibleFrame = frame;
+    visibility_queue.push_back({ start, -1, 0 });
+    for (size_t head = 0; head < visibility_queue.size(); head++) {
+        VisibilityStep step = visibility_queue[head];
+        ChunkSlot *slot = grid.Find(step.pos);
+        const Chunk *chunk = slot->state == ChunkSlot::RESIDENT ? slot->chunk.get() : nullptr;
+
+        for (int d = 0; d < 6; d++) {
+            // Opposite directions differ in the lowest bit
+            if (step.directions & (1 << (d ^ 1)))
+                continue;
+            if (chunk && step.from >= 0 && !chunk->FacesConnected(Chunk::Direction(step.from), Chunk::Direction(d)))
+                continue;
+
+            glm::ivec3 next = step.pos + NEIGHBOR_OFFSETS[d];
+            if (!InRange(next.x, next.y, next.z, last_chunk_x, last_chunk_y, last_chunk_z, 0))
+                continue;
+            ChunkSlot *neighbor = grid.Find(next);
+            if (!neighbor || neighbor->visibleFrame == frame)
+                continue;
+            // The whole chunk rather than its mesh bounds (GetBounds): sight
+            // passes through the air around the mesh too, and an all-air
+            // chunk has no bounds at all. The draw test uses the tight ones.
+            glm::vec3 min = glm::vec3(next) * float(CHUNK_SIZE);
+            if (!frustum.Intersects(min, min + glm::vec3(CHUNK_SIZE)))
+                continue;
+
+            neighbor->visibleFrame = frame;
+            visibility_queue.push_back({ next, d ^ 1, static_cast<uint8_t>(step.directions | (1 << d)) });
         }
+    }
+    return true;
+}
 
-        // Render the chunk
-        if(chunk_loaded){
-            Chunk* chunk = nullptr;
-            {
-                lock_guard<mutex> lock(chunk_mutex);
-                chunk = chunks[chunk_tup];
-            }
-            if (chunk) {
-                chunk->Render();
+// Bring the load set from the box around the last chunk to the box around
+// the new one (from scratch if full). Only positions entering the box are
+// looked at: resident ones join render_list, the rest are queued for loading.
+void World::UpdateLoadSet(int chunk_x, int chunk_y, int chunk_z, bool full) {
+    if (full) {
+        render_list.clear();
+    } else {
+        size_t kept = 0;
+        for (size_t i = 0; i < render_list.size(); i++) {
+            glm::ivec3 pos = glm::ivec3(render_list[i]->offset);
+            if (InRange(pos.x, pos.y, pos.z, chunk_x, chunk_y, chunk_z, 0))
+                render_list[kept++] = move(render_list[i]);
+        }
+        render_list.resize(kept);
+    }
+
+    for (int x = chunk_x - render_distance; x <= chunk_x + render_distance; x++)
+    for (int y = chunk_y - render_height; y <= chunk_y + render_height; y++)
+    for (int z = chunk_z - render_distance; z <= chunk_z + render_distance; z++) {
+        if (!full && InRange(x, y, z, last_chunk_x, last_chunk_y, last_chunk_z, 0))
+            continue;
+
+        glm::ivec3 chunk_pos(x, y, z);
+        ChunkSlot &slot = *grid.Find(chunk_pos);
+
+        // Chunk is loaded (kept from before, within the unload hysteresis)
+        if (slot.state == ChunkSlot::RESIDENT)
+            render_list.push_back(slot.chunk);
+
+        // Chunk is not loaded, queue it by priority
+        else if (slot.state == ChunkSlot::EMPTY)
+            QueueLoad(chunk_pos, slot);
+    }
+}
+
+void World::Update(glm::vec3 player_pos, glm::vec3 view_dir, const Frustum &frustum) {
+    frame++;
+
+    // Get the chunk that the player is in (rounding down, so negative
+    // coordinates land in the right chunk)
+    glm::ivec3 center = glm::ivec3(glm::floor(player_pos / float(CHUNK_SIZE)));
+    int chunk_x = center.x;
+    int chunk_y = center.y;
+    int chunk_z = center.z;
+    bool moved = chunk_x != last_chunk_x || chunk_y != last_chunk_y || chunk_z != last_chunk_z;
+
+    // Reorder the pending loads once the player has moved half a chunk or
+    // turned by more than ~15 degrees
+    glm::vec3 player_chunk_pos = player_pos / float(CHUNK_SIZE);
+    bool reorder = glm::length(player_chunk_pos - priority_pos) > 0.5f || glm::dot(view_dir, priority_view) < 0.966f;
+    if (reorder) {
+        priority_pos = player_chunk_pos;
+        priority_view = view_dir;
+        for (LoadRequest &request : load_queue)
+            request.priority = LoadPriority(request.pos);
+        make_heap(load_queue.begin(), load_queue.end(), LoadBefore);
+    }
+
+    // Chunks that finished loading or meshing since the last frame
+    ProcessCompleted();
+
+    // The load set only changes when the player enters another chunk (or
+    // the render distance changes). Slots that leave the grid are unloaded
+    // or cancelled, the heightmaps of columns left behind are dropped.
+    if (moved || load_set_dirty) {
+        grid.Recenter(center, [this](glm::ivec3, ChunkSlot &slot) { EvictSlot(slot); });
+        UpdateLoadSet(chunk_x, chunk_y, chunk_z, load_set_dirty);
+        CancelLoadsOutside(chunk_x, chunk_y, chunk_z);
+        if (chunk_x != last_chunk_x || chunk_z != last_chunk_z || load_set_dirty)
+            heightmaps.EvictOutside(chunk_x, chunk_z, render_distance + 1);
+        last_chunk_x = chunk_x;
+        last_chunk_y = chunk_y;
+        last_chunk_z = chunk_z;
+        load_set_dirty = false;
+    }
+
+    // Upload within the frame budget, then render the chunks in range that
+    // are in view. Chunks with nothing to draw are not culled or counted;
+    // the visibility search still passes through them.
+    ProcessUploads();
+    render_drawable.clear();
+    render_bounds.Clear();
+    for (const shared_ptr<Chunk> &chunk : render_list) {
+        if (!chunk->HasFaces())
+            continue;
+        glm::vec3 min, max;
+        chunk->GetBounds(min, max);
+        render_bounds.Add(min, max);
+        render_drawable.push_back(chunk.get());
+    }
+    num_chunks_empty = render_list.size() - render_drawable.size();
+    render_visible.resize(render_drawable.size());
+    num_chunks_rendered = frustum.Cull(render_bounds, render_visible.data());
+    num_chunks_culled = render_drawable.size() - num_chunks_rendered;
+
+    // Of those in view, drop the ones hidden behind solid chunks
+    num_chunks_occluded = 0;
+    bool searched = occlusion_culling && FindVisibleChunks(center, frustum);
+    if (searched) {
+        for (size_t i = 0; i < render_drawable.size(); i++) {
+            if (!render_visible[i])
+                continue;
+            ChunkSlot *slot = grid.Find(glm::ivec3(render_drawable[i]->offset));
+            if (!slot || slot->visibleFrame != frame) {
+                render_visible[i] = 0;
+                num_chunks_occluded++;
             }
         }
+        num_chunks_rendered -= num_chunks_occluded;
+    }
+    ReloadEvictedInView(frustum, searched);
+
+    // Draw what is left (headless without a shader, see the constructor)
+    draw_batch.Clear();
+    num_draw_calls = 0;
+    for (size_t i = 0; i < render_drawable.size(); i++) {
+        if (!render_visible[i])
+            continue;
+        render_drawable[i]->lastRendered = frame;
+        if (!shader)
+            continue;
+        if (render_mode == MULTI_DRAW_INDIRECT)
+            render_drawable[i]->AddToBatch(draw_batch);
+        else if (render_drawable[i]->Render())
+            num_draw_calls++;
     }
+    if (shader && render_mode == MULTI_DRAW_INDIRECT)
+        num_draw_calls = draw_batch.Draw(*vertex_arena);
+
+    // Keep within the chunk count and memory limits, then free what the
+    // workers no longer use
+    if (frame % EVICTION_INTERVAL == 0)
+        EvictChunks();
+    FreeUnloadedChunks();
+
+    // Fence the mesh ranges freed this frame, recycle those the GPU is done with
+    vertex_arena->EndFrame();
+
+    // Start loading the nearest chunks in view
+    SubmitLoads();
 }
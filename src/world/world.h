@@ -2,44 +2,249 @@
 #define WORLD_H
 
 #include <vector>
-#include <unordered_map>
-#include <queue>
-#include <set>
-#include <thread>
+#include <deque>
+#include <memory>
 #include <atomic>
-#include <mutex>
 
-#include <util/hashtuple.h>
+#include <util/threadpool.h>
+#include <util/atomiclist.h>
+#include <util/frustum.h>
 #include <world/chunk.h>
+#include <world/chunkgrid.h>
+#include <world/heightmap.h>
 
 class World {
     public:
-        World(Shader *shader);
+        // threads <= 0 uses one chunk worker per hardware thread. Without a
+        // shader chunks are loaded, meshed, uploaded, culled and evicted as
+        // usual but never drawn (headless benchmarks).
+        World(Shader *shader, int threads = 0);
         ~World();
 
         std::vector<Chunk::BlockType> GetChunkData(int chunk_x, int chunk_y, int chunk_z);
-        void Update(glm::vec3 player_pos);
+        // Load, unload and draw chunks around the player. Only chunks inside
+        // frustum (everything by default) are drawn.
+        void Update(glm::vec3 player_pos, glm::vec3 view_dir = glm::vec3(0.0f, 0.0f, -1.0f), const Frustum &frustum = Frustum());
 
-        Chunk* GetChunk(int chunk_x, int chunk_y, int chunk_z);
-        void GenerateChunks();
+        // Chunks loaded around the player, horizontally and vertically
+        void SetRenderDistance(int distance, int height);
+
+        // Loaded chunk at a position, or nullptr (main thread only)
+        std::shared_ptr<Chunk> GetChunk(int chunk_x, int chunk_y, int chunk_z);
+
+        // Per-worker counters of the chunk job system
+        std::vector<ThreadPool::WorkerStats> GetJobStats();
 
         // Global world pointer
         static World *world;
         unsigned int num_chunks = 0, num_chunks_rendered = 0;
-    
+
+        // Chunks in range left out of the last frame by frustum culling
+        unsigned int num_chunks_culled = 0;
+
+        // Chunks in range with nothing to draw (an empty mesh, or none
+        // uploaded yet), left out of the culling and the counts above
+        unsigned int num_chunks_empty = 0;
+
+        // Skip chunks in view that no path through air from the camera's
+        // chunk reaches (see Chunk::faceConnections), and how many were
+        // skipped last frame
+        bool occlusion_culling = true;
+        unsigned int num_chunks_occluded = 0;
+
+        // How the chunks in range are drawn: one draw call each, or one
+        // glMultiDrawElementsIndirect per vertex arena block
+        enum RenderMode {
+            DRAW_PER_CHUNK,
+            MULTI_DRAW_INDIRECT
+        };
+        RenderMode render_mode = MULTI_DRAW_INDIRECT;
+        unsigned int num_draw_calls = 0;
+
+        // Chunk loads dropped because the player moved out of range first,
+        // and mesh jobs skipped because their chunk was unloaded before they
+        // started
+        std::atomic<unsigned int> num_loads_cancelled{0};
+        std::atomic<unsigned int> num_meshes_cancelled{0};
+        unsigned int num_chunks_evicted = 0;
+
+        // Eviction limits for loaded chunks, on top of unloading everything
+        // beyond the render distance. They hold even when the render
+        // distance needs more: chunks in range are evicted too (after those
+        // beyond it) and load again once they come back into view, or, if
+        // they had nothing to draw, once they leave the grid and return.
+        size_t max_resident_chunks = 4096;
+        size_t memory_budget = size_t(512) << 20;
+
+        // Bytes held by the loaded chunks, as the memory budget counts them
+        size_t MemoryUsage();
+
+        // Mesh uploads per frame stop once either budget is used up (at
+        // least one upload always runs); the rest carry over to later frames
+        size_t upload_bytes_per_frame = size_t(4) << 20;
+        double upload_ms_per_frame = 2.0;
+
+        // Upload queue metrics: what is still waiting, and what the last
+        // frame uploaded
+        size_t num_uploads_pending = 0, upload_bytes_pending = 0;
+        unsigned int num_uploads_last_frame = 0;
+        size_t upload_bytes_last_frame = 0;
+
     private:
-        std::unordered_map<std::tuple<int, int, int>, Chunk*> chunks;
-        std::queue<glm::vec3> chunk_queue;
-        std::set<std::tuple<int, int, int>> chunks_to_render;
+        // State of one position in the grid around the player. The slot
+        // owns its chunk: render_list and jobs only borrow it, and a chunk
+        // leaving its slot (unloaded or evicted) leaves render_list too.
+        struct ChunkSlot {
+            enum State {
+                EMPTY,
+                QUEUED,     // waiting in load_queue
+                LOADING,    // handed to the job system
+                RESIDENT,
+                EVICTED     // unloaded by the limits while in range
+            };
+            State state = EMPTY;
+            CancelToken token;
+            std::shared_ptr<Chunk> chunk;
+
+            // Shared by the chunk's mesh jobs, cancelled when it leaves the slot
+            CancelToken meshToken;
+
+            // A mesh job is running, and it started before a neighbor arrived
+            bool meshing = false;
+            bool meshStale = false;
+
+            // A mesh of the chunk has been uploaded
+            bool uploaded = false;
+
+            // Frame the visibility search last reached this position
+            unsigned int visibleFrame = 0;
+        };
+
+        // Work finished by a job, handed back to the main thread
+        struct Completion {
+            glm::ivec3 pos;
+            std::shared_ptr<Chunk> chunk;   // nullptr for a cancelled job
+            CancelToken token;
+            bool meshed;                    // mesh job, otherwise load job
+            size_t bytes;                   // size of the mesh
+        };
+
+        // Meshes waiting for upload, oldest first
+        struct PendingUpload {
+            glm::ivec3 pos;
+            std::shared_ptr<Chunk> chunk;
+            size_t bytes;
+        };
+        std::deque<PendingUpload> upload_queue;
+        void ProcessUploads();
+
+        // Slots for every chunk within the render distance plus
+        // UNLOAD_HYSTERESIS, indexed by chunk position. Only the main thread
+        // reads or writes it, so lookups take no lock; workers get the chunks
+        // they need when their job is created.
+        ChunkGrid<ChunkSlot> grid;
+
+        // Resident chunks within the render distance, drawn every frame.
+        // Rebuilt from the entering and leaving positions when the player
+        // changes chunk.
+        std::vector<std::shared_ptr<Chunk>> render_list;
+        bool load_set_dirty = true;
+
+        // The render_list chunks with faces to draw, their bounds and
+        // whether each is in view, rebuilt every frame
+        std::vector<Chunk*> render_drawable;
+        Frustum::Boxes render_bounds;
+        std::vector<uint8_t> render_visible;
+
+        // Breadth-first search from the camera's chunk (start) through
+        // connected faces; marks the slots it reaches with the current frame.
+        // Returns false if the camera is outside the grid.
+        struct VisibilityStep {
+            glm::ivec3 pos;
+            int from;               // face entered through, -1 at the camera
+            uint8_t directions;     // bit per Direction stepped in so far
+        };
+        std::vector<VisibilityStep> visibility_queue;
+        bool FindVisibleChunks(glm::ivec3 start, const Frustum &frustum);
+
+        // Finished jobs since the last frame. Workers push without a lock
+        // and the main thread takes the whole list once per frame, so the
+        // frame never waits on a worker.
+        AtomicList<Completion> completed;
+
+        bool InRange(int x, int y, int z, int chunk_x, int chunk_y, int chunk_z, int margin) const;
+        void UpdateLoadSet(int chunk_x, int chunk_y, int chunk_z, bool full);
+        void ProcessCompleted();
+        void InsertChunk(glm::ivec3 chunk_pos, ChunkSlot &slot, std::shared_ptr<Chunk> chunk);
+        void EvictSlot(ChunkSlot &slot);
+
+        // Jobs
+        void LoadChunk(glm::ivec3 chunk_pos, CancelToken token);
+        void SubmitMesh(glm::ivec3 chunk_pos, ChunkSlot &slot);
+
+        // Chunks taken out of the grid whose GL objects still need freeing
+        std::vector<std::shared_ptr<Chunk>> unloaded_chunks;
+        unsigned int frame = 0;
+
+        // Chunks beyond the render distance plus this are unloaded
+        static const int UNLOAD_HYSTERESIS = 2;
+        // Frames between checks of the LRU and memory limits
+        static const unsigned int EVICTION_INTERVAL = 60;
+
+        void EvictChunks();
+        void FreeUnloadedChunks();
+
+        // Positions left EVICTED in range, with the bounds their chunk had;
+        // loaded again once those are in view
+        struct EvictedChunk {
+            glm::ivec3 pos;
+            glm::vec3 min, max;
+        };
+        std::vector<EvictedChunk> evicted_chunks;
+        void ReloadEvictedInView(const Frustum &frustum, bool searched);
+
+        // Chunks to load, as a heap with the lowest priority value on top.
+        // At most max_loads_in_flight of them are handed to the job system
+        // at a time so the order stays live.
+        struct LoadRequest {
+            float priority;
+            glm::ivec3 pos;
+        };
+        std::vector<LoadRequest> load_queue;
+        int loads_in_flight = 0;
+        int max_loads_in_flight;
+
+        // Extra chunks beyond the render distance before a load is cancelled,
+        // so moving back and forth over a chunk border does not thrash
+        static const int LOAD_HYSTERESIS = 1;
+
+        // Player position (in chunks) and view direction the queue was
+        // ordered for
+        glm::vec3 priority_pos = glm::vec3(0.0f);
+        glm::vec3 priority_view = glm::vec3(0.0f, 0.0f, -1.0f);
+
+        float LoadPriority(glm::ivec3 chunk_pos) const;
+        static bool LoadBefore(const LoadRequest &a, const LoadRequest &b);
+        void QueueLoad(glm::ivec3 chunk_pos, ChunkSlot &slot);
+        void SubmitLoads();
+        void CancelLoadsOutside(int chunk_x, int chunk_y, int chunk_z);
         int render_distance = 5;
         int render_height = 2;
-        unsigned int chunks_loading = 0;
+
+        // Scratch vertex buffers, one pool per worker, returned after upload
+        std::unique_ptr<BufferPool<uint32_t>[]> mesh_pools;
+
+        // GPU storage for every chunk mesh (see Chunk::vertexArena)
+        std::unique_ptr<VertexArena> vertex_arena;
+        MultiDrawBatch draw_batch;
+
+        // Surface heights shared by the vertical chunks of each column
+        HeightmapCache heightmaps;
+        int last_chunk_x = 0, last_chunk_y = 0, last_chunk_z = 0;
 
         Shader *shader;
 
-        std::thread chunk_thread;
-        std::atomic<bool> running;
-        std::mutex chunk_mutex;
+        std::unique_ptr<ThreadPool> jobs;
 };
 
-#endif
\ No newline at end of file
+#endif